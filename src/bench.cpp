@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "simulation.cpp"
+#include "shard.hpp"
+
+// Fixed workloads through run_simulation(), no graphics or sleeping, results as JSON on stdout.
+// Every workload runs in its own process, so peak_rss_kb is its own and not the max of everything before it.
+//
+// bench [--threads N] [--scale F] [--only NAME] [--side N|all] [--rule B3/S23] [--block K] [--torus WxH] [--shards N]
+//       [--hashlife]
+//   --threads  0 ticks serially, default is one per hardware thread
+//   --scale    multiplies every generation count
+//   --only     runs the workloads whose name starts with NAME
+//   --side     chunk side, 32 (default), 64, 128 or 256, all runs every workload with each
+//   --rule     Life-like rule the workloads run under, Life by default
+//   --block    generations per tick, temporal blocking (see tick_bitwise()), 1 by default
+//   --torus    runs the workloads on a W x H DenseGrid torus instead, seeded with the cells around the origin
+//   --shards   runs the workloads over N worker processes instead (see ShardCoordinator), --threads is ignored
+//   --hashlife jumps through the generations with a HashLifeEngine instead, single threaded
+
+struct Workload
+{
+    const char *name;
+    int generations;
+    std::function<void(BoolChunkLoader&)> seed;
+};
+
+// Same soup on every machine, unlike rand()
+void set_soup(BoolChunkLoader &life, const int size, const int percent, uint64_t state)
+{
+    for(int y = 0; y < size; y++)
+    {
+        for(int x = 0; x < size; x++)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            if(state % 100 < (uint64_t)percent)
+                life.set({x - size / 2, y - size / 2}, 1);
+        }
+    }
+}
+
+static const Workload workloads[] = {
+    {"acorn", 5206, [](BoolChunkLoader &life) { set_acorn(life); }},
+    {"r_pentomino", 1103, [](BoolChunkLoader &life) { set_r_pentomino(Offset2D(&life, {0, 0})); }},
+    {"gosper_gun", 3000, [](BoolChunkLoader &life) { set_gosper_gun(life); }},
+    {"soup_10", 1000, [](BoolChunkLoader &life) { set_soup(life, 1024, 10, 0x9E3779B97F4A7C15ull); }},
+    {"soup_30", 1000, [](BoolChunkLoader &life) { set_soup(life, 1024, 30, 0x9E3779B97F4A7C15ull); }},
+    {"soup_50", 1000, [](BoolChunkLoader &life) { set_soup(life, 1024, 50, 0x9E3779B97F4A7C15ull); }},
+    {"vertical_pattern", 1000, [](BoolChunkLoader &life) { set_vertical_pattern(Offset2D(&life, {0, 0})); }},
+};
+
+template<int Shift>
+void run_workload(const Workload &workload, const int generations, const int threads, const LifeRule &rule, const int block)
+{
+    typedef BasicBoolChunk<Shift> Chunk;
+    WorkStealingPool *pool = threads > 0 ? new WorkStealingPool(threads) : nullptr;
+    // seeded at the default size, the patterns take a BoolChunkLoader
+    BoolChunkLoader *seed = new BoolChunkLoader;
+    workload.seed(*seed);
+    BasicBoolChunkLoader<Chunk> *life = new BasicBoolChunkLoader<Chunk>;
+    copy_cells(*seed, *life);
+    delete seed;
+    life->set_rule(rule);
+    double seconds = 0;
+    uint64_t chunk_generations = 0;
+    for(int i = 0; i < generations; )
+    {
+        // one tick at a time, so the chunk count is sampled as often as with block 1
+        const int tick = std::min(std::min(block, ChunkRegion<Chunk>::pad), generations - i);
+        auto start = std::chrono::steady_clock::now();
+        run_simulation(life, 0, tick, false, 64, Vect2i(), false, pool, false, tick);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        chunk_generations += life->chunk_count() * tick;
+        i += tick;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // cell updates count every cell of every loaded chunk, the area the engine is responsible for
+    const uint64_t cell_updates = chunk_generations * Chunk::chunk_size_b;
+    printf("    {\"name\": \"%s\", \"engine\": \"chunks\", \"side\": %d, \"block\": %d, \"generations\": %d, \"seconds\": %.6f, \"generations_per_sec\": %.1f, "
+        "\"cell_updates_per_sec\": %.1f, \"chunks_per_sec\": %.1f, \"final_population\": %lld, \"final_chunks\": %zu, "
+        "\"final_live_chunks\": %lld, \"peak_rss_kb\": %ld}",
+        workload.name, Chunk::side_len_b, std::min(block, ChunkRegion<Chunk>::pad), generations, seconds, generations / seconds,
+        cell_updates / seconds, chunk_generations / seconds, (long long)life->population(), life->chunk_count(),
+        (long long)life->live_chunk_count(), usage.ru_maxrss);
+    fflush(stdout);
+}
+
+template<int Shift>
+void run_sharded_workload(const Workload &workload, const int generations, const int shards, const LifeRule &rule,
+    const int block)
+{
+    typedef BasicBoolChunk<Shift> Chunk;
+    BoolChunkLoader *seed = new BoolChunkLoader;
+    workload.seed(*seed);
+    BasicBoolChunkLoader<Chunk> *life = new BasicBoolChunkLoader<Chunk>;
+    copy_cells(*seed, *life);
+    delete seed;
+    ShardCoordinator<Chunk> coordinator(shards, 8, rule);
+    if(!coordinator.ok() || !coordinator.scatter(*life))
+        exit(1);
+    delete life;
+    double seconds = 0;
+    uint64_t chunk_generations = 0;
+    for(int i = 0; i < generations; )
+    {
+        auto start = std::chrono::steady_clock::now();
+        const int done = coordinator.step(std::min(block, generations - i));
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(done == 0)
+            exit(1);
+        chunk_generations += coordinator.stats().chunks * done;
+        i += done;
+    }
+    // the workers are not counted, their memory is their own
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const uint64_t cell_updates = chunk_generations * Chunk::chunk_size_b;
+    printf("    {\"name\": \"%s\", \"engine\": \"shards\", \"shards\": %d, \"side\": %d, \"block\": %d, \"generations\": %d, "
+        "\"seconds\": %.6f, \"generations_per_sec\": %.1f, \"cell_updates_per_sec\": %.1f, \"chunks_per_sec\": %.1f, "
+        "\"final_population\": %lld, \"final_chunks\": %lld, \"coordinator_rss_kb\": %ld}",
+        workload.name, shards, Chunk::side_len_b, std::min(block, ChunkRegion<Chunk>::pad), generations, seconds,
+        generations / seconds, cell_updates / seconds, chunk_generations / seconds,
+        (long long)coordinator.stats().population, (long long)coordinator.stats().chunks, usage.ru_maxrss);
+    fflush(stdout);
+}
+
+void run_hashlife_workload(const Workload &workload, const int generations, const LifeRule &rule)
+{
+    HashLifeEngine engine(1 << 24, rule);
+    {
+        // only the engine is kept
+        BoolChunkLoader life;
+        workload.seed(life);
+        engine.import_from(life);
+    }
+    auto start = std::chrono::steady_clock::now();
+    if(!engine.step(generations))
+        exit(1);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("    {\"name\": \"%s\", \"engine\": \"hashlife\", \"generations\": %d, \"seconds\": %.6f, "
+        "\"generations_per_sec\": %.1f, \"final_population\": %llu, \"nodes\": %zu, \"peak_rss_kb\": %ld}",
+        workload.name, generations, seconds, generations / seconds, (unsigned long long)engine.population(),
+        engine.node_count(), usage.ru_maxrss);
+    fflush(stdout);
+}
+
+void run_torus_workload(const Workload &workload, const int generations, const int threads, const LifeRule &rule,
+    const int width, const int height)
+{
+    WorkStealingPool *pool = threads > 0 ? new WorkStealingPool(threads) : nullptr;
+    BoolChunkLoader *seed = new BoolChunkLoader;
+    workload.seed(*seed);
+    DenseGrid grid(width, height, Edge::wrap, rule);
+    grid.copy_from(*seed, {-width / 2, -height / 2});
+    delete seed;
+    auto start = std::chrono::steady_clock::now();
+    grid.step(generations, pool);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const double cell_updates = (double)width * height * generations;
+    printf("    {\"name\": \"%s\", \"engine\": \"torus\", \"width\": %d, \"height\": %d, \"generations\": %d, \"seconds\": %.6f, "
+        "\"generations_per_sec\": %.1f, \"cell_updates_per_sec\": %.1f, \"final_population\": %lld, \"peak_rss_kb\": %ld}",
+        workload.name, width, height, generations, seconds, generations / seconds, cell_updates / seconds,
+        (long long)grid.population(), usage.ru_maxrss);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    double scale = 1;
+    const char *only = "";
+    std::vector<int> sides = {32};
+    LifeRule rule;
+    int block = 1;
+    int torus_width = 0, torus_height = 0;
+    int shards = 0;
+    bool hashlife = false;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+            scale = atof(argv[++i]);
+        else if(strcmp(argv[i], "--only") == 0 && i + 1 < argc)
+            only = argv[++i];
+        else if(strcmp(argv[i], "--side") == 0 && i + 1 < argc && strcmp(argv[i + 1], "all") == 0)
+        {
+            sides = {32, 64, 128, 256};
+            i++;
+        }
+        else if(strcmp(argv[i], "--side") == 0 && i + 1 < argc && with_chunk_side(atoi(argv[i + 1]), [](auto) {}))
+            sides = {atoi(argv[++i])};
+        else if(strcmp(argv[i], "--rule") == 0 && i + 1 < argc && LifeRule::parse(argv[i + 1], rule))
+            i++;
+        else if(strcmp(argv[i], "--block") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1)
+            block = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--torus") == 0 && i + 1 < argc
+            && sscanf(argv[i + 1], "%dx%d", &torus_width, &torus_height) == 2 && torus_width > 0 && torus_height > 0)
+            i++;
+        else if(strcmp(argv[i], "--shards") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1)
+            shards = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--hashlife") == 0)
+            hashlife = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [--threads N] [--scale F] [--only NAME] [--side 32|64|128|256|all] [--rule B3/S23] [--block K] "
+                "[--torus WxH] [--shards N] [--hashlife]\n", argv[0]);
+            return 1;
+        }
+    }
+#ifdef __OPTIMIZE__
+    const bool optimized = true;
+#else
+    const bool optimized = false; // numbers from a build without -O mean little, use -DCMAKE_BUILD_TYPE=Release
+#endif
+    // rule_baked is false when the kernels run the rule from tables, a slower path than the rules compiled in
+    printf("{\n  \"kernel\": \"%s\",\n  \"threads\": %d,\n  \"optimized\": %s,\n  \"rule\": \"%s\",\n  \"rule_baked\": %s,\n"
+        "  \"workloads\": [\n", kernel_isa_name(kernel_isa()), threads, optimized ? "true" : "false", rule.to_string().c_str(),
+        kernel_rule_baked(rule) ? "true" : "false");
+    bool first = true;
+    for(const Workload &workload : workloads)
+    {
+        if(strncmp(workload.name, only, strlen(only)) != 0)
+            continue;
+        // the other engines have no chunk side
+        for(const int side : torus_width || hashlife ? std::vector<int>{0} : sides)
+        {
+            if(!first)
+                printf(",\n");
+            first = false;
+            fflush(stdout);
+            const pid_t child = fork();
+            if(child == 0)
+            {
+                const int generations = std::max(1, (int)(workload.generations * scale));
+                if(hashlife)
+                    run_hashlife_workload(workload, generations, rule);
+                else if(torus_width)
+                    run_torus_workload(workload, generations, threads, rule, torus_width, torus_height);
+                else if(shards)
+                    with_chunk_side(side, [&](auto shift) { run_sharded_workload<decltype(shift)::value>(workload, generations, shards, rule, block); });
+                else
+                    with_chunk_side(side, [&](auto shift) { run_workload<decltype(shift)::value>(workload, generations, threads, rule, block); });
+                _exit(0);
+            }
+            int status = 0;
+            waitpid(child, &status, 0);
+            if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                fprintf(stderr, "%s failed\n", workload.name);
+                return 1;
+            }
+        }
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+
+template<class T>
+class FlatPtrMap
+{
+    /**
+     * @brief Open addressing hash map from 64 bit keys to non-null pointers
+     * Linear probing in one flat array, no nodes. Erase shifts the rest of the cluster back,
+     * so there are no tombstones and lookups never slow down after many kills.
+     * A null value marks an empty slot.
+     */
+public:
+    struct Slot
+    {
+        uint64_t key;
+        T *value;
+    };
+
+private:
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
+    int shift = 64;
+
+    inline size_t home(const uint64_t key) const
+    {
+        // fibonacci hashing, the top bits are well mixed even for small coordinates
+        return (key * 0x9E3779B97F4A7C15ull) >> shift;
+    }
+
+    void rehash(const size_t capacity)
+    {
+        std::vector<Slot> old(capacity, Slot{0, nullptr});
+        old.swap(slots);
+        mask = capacity - 1;
+        shift = 64 - __builtin_ctzll(capacity);
+        for(auto iter = old.begin(); iter != old.end(); ++iter)
+        {
+            if(!iter->value)
+                continue;
+            size_t i = home(iter->key);
+            while(slots[i].value)
+                i = (i + 1) & mask;
+            slots[i] = *iter;
+        }
+    }
+
+    // Removes slot i, pulling back the entries after it that would otherwise be unreachable
+    void erase_slot(size_t i)
+    {
+        size_t j = i;
+        while(true)
+        {
+            j = (j + 1) & mask;
+            if(!slots[j].value)
+                break;
+            size_t k = home(slots[j].key);
+            // k cyclically in (i, j] means the entry at j is still reachable
+            if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+                continue;
+            slots[i] = slots[j];
+            i = j;
+        }
+        slots[i] = Slot{0, nullptr};
+        count--;
+    }
+
+public:
+    // S is Slot, or const Slot for going through a const map, the values are pointers either way
+    template<class S>
+    class basic_iterator
+    {
+        S *pos, *end;
+        void skip()
+        {
+            while(pos != end && !pos->value)
+                ++pos;
+        }
+    public:
+        basic_iterator(S *pos, S *end) : pos(pos), end(end)
+        {
+            skip();
+        }
+        S& operator*() const
+        {
+            return *pos;
+        }
+        S* operator->() const
+        {
+            return pos;
+        }
+        basic_iterator& operator++()
+        {
+            ++pos;
+            skip();
+            return *this;
+        }
+        bool operator!=(const basic_iterator &other) const
+        {
+            return pos != other.pos;
+        }
+        bool operator==(const basic_iterator &other) const
+        {
+            return pos == other.pos;
+        }
+    };
+    typedef basic_iterator<Slot> iterator;
+    typedef basic_iterator<const Slot> const_iterator;
+
+    FlatPtrMap(size_t capacity = 64)
+    {
+        size_t pow2 = 16;
+        while(pow2 < capacity)
+            pow2 <<= 1;
+        rehash(pow2);
+    }
+
+    iterator begin()
+    {
+        return iterator(slots.data(), slots.data() + slots.size());
+    }
+    iterator end()
+    {
+        return iterator(slots.data() + slots.size(), slots.data() + slots.size());
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(slots.data(), slots.data() + slots.size());
+    }
+    const_iterator end() const
+    {
+        return const_iterator(slots.data() + slots.size(), slots.data() + slots.size());
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    T* find(const uint64_t key) const
+    {
+        for(size_t i = home(key); slots[i].value; i = (i + 1) & mask)
+        {
+            if(slots[i].key == key)
+                return slots[i].value;
+        }
+        return nullptr;
+    }
+
+    // Many lookups at once, the home slots are all prefetched before the first probe
+    void find(const uint64_t *keys, T **values, const int n) const
+    {
+        for(int i = 0; i < n; i++)
+            __builtin_prefetch(&slots[home(keys[i])]);
+        for(int i = 0; i < n; i++)
+            values[i] = find(keys[i]);
+    }
+
+    // Does nothing if the key is already there
+    void insert(const uint64_t key, T *value)
+    {
+        if((count + 1) * 2 > slots.size()) // keep load under 1/2, probes stay short
+            rehash(slots.size() * 2);
+        size_t i = home(key);
+        while(slots[i].value)
+        {
+            if(slots[i].key == key)
+                return;
+            i = (i + 1) & mask;
+        }
+        slots[i] = Slot{key, value};
+        count++;
+    }
+
+    // Returns the erased value or null
+    T* erase(const uint64_t key)
+    {
+        for(size_t i = home(key); slots[i].value; i = (i + 1) & mask)
+        {
+            if(slots[i].key == key)
+            {
+                T *value = slots[i].value;
+                erase_slot(i);
+                return value;
+            }
+        }
+        return nullptr;
+    }
+
+    // Erases every entry fn returns true for.
+    // Entries pulled back over the end of the array may be passed to fn twice, after it returned false for them.
+    template<class Fn>
+    void erase_if(Fn fn)
+    {
+        for(size_t i = 0; i < slots.size(); )
+        {
+            if(slots[i].value && fn(slots[i]))
+                erase_slot(i); // something else may have moved into i
+            else
+                i++;
+        }
+    }
+};
@@ -0,0 +1,96 @@
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "chunk_map.hpp"
+#include "tests.hpp"
+
+// FlatPtrMap against std::map under random inserts and erases, with few keys and a small table so clusters are
+// long and get erased out of the middle all the time
+
+// Every key finds what the reference has, and going through the map sees each entry once
+bool same(FlatPtrMap<int> &map, const std::map<uint64_t, int*> &reference, const std::vector<uint64_t> &keys)
+{
+    if(map.size() != reference.size())
+        return false;
+    for(const uint64_t key : keys)
+    {
+        const auto expected = reference.find(key);
+        if(map.find(key) != (expected == reference.end() ? nullptr : expected->second))
+            return false;
+    }
+    size_t seen = 0;
+    for(auto iter = map.begin(); iter != map.end(); ++iter)
+    {
+        const auto expected = reference.find(iter->key);
+        if(expected == reference.end() || expected->second != iter->value)
+            return false;
+        seen++;
+    }
+    return seen == reference.size();
+}
+
+void check_map(const std::vector<uint64_t> &keys, const std::string &what)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    std::vector<int> values(keys.size());
+    FlatPtrMap<int> map(16);
+    std::map<uint64_t, int*> reference;
+    bool ok = true;
+    for(int op = 0; ok && op < 20000; op++)
+    {
+        const size_t i = next_random(state) % keys.size();
+        if(next_random(state) % 3 == 0)
+        {
+            const auto expected = reference.find(keys[i]);
+            ok = map.erase(keys[i]) == (expected == reference.end() ? nullptr : expected->second);
+            reference.erase(keys[i]);
+        }
+        else
+        {
+            map.insert(keys[i], &values[i]);
+            reference.insert({keys[i], &values[i]});
+        }
+        ok = ok && same(map, reference, keys);
+    }
+    check(ok, "insert and erase, " + what);
+
+    std::vector<int*> found(keys.size());
+    map.find(keys.data(), found.data(), keys.size());
+    ok = true;
+    for(size_t i = 0; i < keys.size(); i++)
+        ok = ok && found[i] == map.find(keys[i]);
+    check(ok, "batched find, " + what);
+
+    // every third key, whatever order the slots are visited and pulled back in
+    map.erase_if([](const FlatPtrMap<int>::Slot &slot) { return slot.key % 3 == 0; });
+    for(auto iter = reference.begin(); iter != reference.end(); )
+    {
+        if(iter->first % 3 == 0)
+            iter = reference.erase(iter);
+        else
+            ++iter;
+    }
+    check(same(map, reference, keys), "erase_if, " + what);
+}
+
+int main()
+{
+    for(const uint64_t count : {8, 40, 300})
+    {
+        std::vector<uint64_t> keys;
+        for(uint64_t key = 0; key < count; key++)
+            keys.push_back(key);
+        check_map(keys, std::to_string(count) + " keys");
+    }
+    // keys whose home is one of the last slots of a 16 or 32 slot table, so the clusters wrap around the end
+    std::vector<uint64_t> keys;
+    for(uint64_t key = 0; keys.size() < 12; key++)
+    {
+        if((key * 0x9E3779B97F4A7C15ull) >> 60 == 15)
+            keys.push_back(key);
+    }
+    check_map(keys, "clusters over the end");
+    return test_result();
+}
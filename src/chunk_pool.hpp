@@ -0,0 +1,207 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+#include <chunk_map.hpp>
+
+// Slots per slab, 256 halved until a slab is at most an eighth of an arena. A 128 cell chunk pair in slabs of 256
+// would leave room for one slab per arena and waste nearly half of it
+constexpr int slab_slots_for(const size_t slot_size, const size_t arena_size)
+{
+    int slots = 256;
+    while(slots > 1 && slots * slot_size > arena_size / 8)
+        slots /= 2;
+    return slots;
+}
+
+template<class T>
+class ChunkPool
+{
+    /**
+     * @brief Slab allocator for chunks
+     * Memory comes in 2MB aligned arenas (optionally huge pages), cut into page aligned slabs of 256 slots, fewer for
+     * big chunks so an arena splits into slabs with little left over (see slab_slots_for()).
+     * Chunks in the same square region share a slab while it has room, so spatial neighbours stay close in memory.
+     * A region holds at least a slab worth of chunks, 16x16 for the smaller chunk sizes.
+     * Once more than dead_limit slots sit unused, empty slabs are handed back to the os with MADV_DONTNEED.
+     */
+public:
+    static const size_t page_size = 4096;
+    static const size_t arena_size = 2 << 20;
+    static const size_t slot_size = (sizeof(T) + alignof(T) - 1) / alignof(T) * alignof(T);
+    static const int slab_slots = slab_slots_for(slot_size, arena_size);
+    static const int region_shift = (__builtin_ctz(slab_slots) + 1) / 2; // 16x16 chunks per region for 256 slots
+    static const size_t slab_size = (slab_slots * slot_size + page_size - 1) / page_size * page_size;
+    static const int arena_slabs = arena_size / slab_size;
+    static_assert(arena_slabs > 0, "Chunk type too big for an arena");
+
+private:
+    struct Slab
+    {
+        char *base;
+        uint64_t free_mask[(slab_slots + 63) / 64]; // set bit means free slot
+        int used;
+        uint64_t region;
+        bool resident;
+    };
+    struct Arena
+    {
+        Slab slabs[arena_slabs];
+    };
+
+    FlatPtrMap<Arena> arenas; // by base address / arena_size
+    FlatPtrMap<Slab> regions; // slab currently filled for each region
+    std::vector<Slab*> empty, released;
+    size_t free_slots = 0; // unused slots in resident slabs
+    size_t dead_limit;
+    bool huge_pages;
+
+    static inline uint64_t region_key(const int x, const int y)
+    {
+        return (uint64_t)(uint32_t)(x >> region_shift) << 32 | (uint32_t)(y >> region_shift);
+    }
+
+    Slab* slab_of(const void *ptr, int &slot) const
+    {
+        const uintptr_t addr = (uintptr_t)ptr;
+        Arena *arena = arenas.find(addr / arena_size);
+        const size_t offset = addr % arena_size;
+        Slab *slab = &arena->slabs[offset / slab_size];
+        slot = (offset % slab_size) / slot_size;
+        return slab;
+    }
+
+    void new_arena()
+    {
+        // over-allocate, then trim so the arena is aligned to its size
+        char *raw = (char*)mmap(nullptr, 2 * arena_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(raw == MAP_FAILED)
+            throw std::bad_alloc();
+        char *base = (char*)(((uintptr_t)raw + arena_size - 1) / arena_size * arena_size);
+        if(base != raw)
+            munmap(raw, base - raw);
+        munmap(base + arena_size, raw + arena_size - base);
+#ifdef MADV_HUGEPAGE
+        if(huge_pages)
+            madvise(base, arena_size, MADV_HUGEPAGE);
+#endif
+        Arena *arena = new Arena;
+        for(int i = arena_slabs - 1; i >= 0; i--)
+        {
+            Slab &slab = arena->slabs[i];
+            slab.base = base + i * slab_size;
+            slab.used = 0;
+            slab.resident = false; // fresh pages are not backed yet
+            released.push_back(&slab);
+        }
+        arenas.insert((uintptr_t)base / arena_size, arena);
+    }
+
+    Slab* take_slab(const uint64_t region)
+    {
+        Slab *slab;
+        if(!empty.empty())
+        {
+            slab = empty.back();
+            empty.pop_back();
+        }
+        else
+        {
+            if(released.empty())
+                new_arena();
+            slab = released.back();
+            released.pop_back();
+            slab->resident = true;
+            free_slots += slab_slots;
+        }
+        for(int i = 0; i < (slab_slots + 63) / 64; i++)
+            slab->free_mask[i] = slab_slots - i * 64 >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (slab_slots - i * 64)) - 1;
+        slab->region = region;
+        regions.erase(region);
+        regions.insert(region, slab);
+        return slab;
+    }
+
+    void release_idle()
+    {
+        while(free_slots > dead_limit && !empty.empty())
+        {
+            Slab *slab = empty.back();
+            empty.pop_back();
+            madvise(slab->base, slab_size, MADV_DONTNEED);
+            slab->resident = false;
+            free_slots -= slab_slots;
+            released.push_back(slab);
+        }
+    }
+
+public:
+    ChunkPool(size_t dead_limit = 1 << 16, bool huge_pages = false) : dead_limit(dead_limit), huge_pages(huge_pages)
+    {
+    }
+
+    // Memory for one T at chunk index (x, y), not constructed
+    void* allocate(const int x, const int y)
+    {
+        const uint64_t region = region_key(x, y);
+        Slab *slab = regions.find(region);
+        if(!slab || slab->used == slab_slots)
+            slab = take_slab(region);
+        int word = 0;
+        while(slab->free_mask[word] == 0)
+            word++;
+        const int bit = __builtin_ctzll(slab->free_mask[word]);
+        slab->free_mask[word] &= ~((uint64_t)1 << bit);
+        slab->used++;
+        free_slots--;
+        return slab->base + (word * 64 + bit) * slot_size;
+    }
+
+    // Takes back memory from allocate(), the T must already be destroyed
+    void free(void *ptr)
+    {
+        int slot;
+        Slab *slab = slab_of(ptr, slot);
+        slab->free_mask[slot / 64] |= (uint64_t)1 << (slot % 64);
+        slab->used--;
+        free_slots++;
+        Slab *current = regions.find(slab->region);
+        if(slab->used == 0)
+        {
+            if(current == slab)
+                regions.erase(slab->region);
+            empty.push_back(slab);
+            release_idle();
+        }
+        else if(!current || current->used == slab_slots)
+        {
+            // reuse the hole for the same region
+            regions.erase(slab->region);
+            regions.insert(slab->region, slab);
+        }
+    }
+
+    void set_dead_limit(const size_t limit)
+    {
+        dead_limit = limit;
+        release_idle();
+    }
+
+    // Unused chunk slots still backed by memory
+    size_t dead_count() const
+    {
+        return free_slots;
+    }
+
+    ~ChunkPool()
+    {
+        for(auto iter = arenas.begin(); iter != arenas.end(); ++iter)
+        {
+            munmap((void*)(iter->key * arena_size), arena_size);
+            delete iter->value;
+        }
+    }
+};
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "chunk_pool.hpp"
+#include "chunks.cpp"
+#include "tests.hpp"
+
+// ChunkPool hands out separate slots, keeps regions together in slabs, reuses holes, gives idle slabs back
+// and splits its arenas into slabs with little left over
+
+// Stands in for a chunk pair of about the same size
+template<int Words>
+struct Fake
+{
+    uint64_t words[Words];
+};
+
+template<class Fake>
+struct Allocation
+{
+    int x, y;
+    Fake *fake;
+};
+
+// A square of chunk indices around the origin, each slot filled with its own pattern
+template<class Fake>
+std::vector<Allocation<Fake>> allocate_square(ChunkPool<Fake> &pool, const int side)
+{
+    std::vector<Allocation<Fake>> allocations;
+    for(int y = -side / 2; y < side - side / 2; y++)
+    {
+        for(int x = -side / 2; x < side - side / 2; x++)
+        {
+            Fake *fake = (Fake*)pool.allocate(x, y);
+            for(uint64_t &word : fake->words)
+                word = (uint64_t)(uint32_t)x << 32 | (uint32_t)y;
+            allocations.push_back({x, y, fake});
+        }
+    }
+    return allocations;
+}
+
+template<class Fake>
+bool patterns_intact(const std::vector<Allocation<Fake>> &allocations)
+{
+    for(const Allocation<Fake> &allocation : allocations)
+    {
+        for(const uint64_t word : allocation.fake->words)
+        {
+            if(word != ((uint64_t)(uint32_t)allocation.x << 32 | (uint32_t)allocation.y))
+                return false;
+        }
+    }
+    return true;
+}
+
+template<class Fake>
+void check_pool(const std::string &name, const int side)
+{
+    typedef ChunkPool<Fake> Pool;
+    const std::string what = " (" + name + ", " + std::to_string(Pool::slab_slots) + " slots a slab)";
+    {
+        Pool pool;
+        // more than one arena worth, side a multiple of the region side
+        const std::vector<Allocation<Fake>> allocations = allocate_square(pool, side);
+        std::set<Fake*> distinct;
+        bool aligned = true;
+        for(const Allocation<Fake> &allocation : allocations)
+        {
+            distinct.insert(allocation.fake);
+            aligned = aligned && (uintptr_t)allocation.fake % alignof(Fake) == 0;
+        }
+        check(distinct.size() == allocations.size() && aligned, "every slot separate and aligned" + what);
+        check(patterns_intact(allocations), "no slot overlaps another" + what);
+
+        // a region is 2^region_shift chunks square, its chunks fill slabs of their own one after the other
+        std::map<uint64_t, std::set<uintptr_t>> slabs_of_region;
+        std::map<uintptr_t, std::set<uint64_t>> regions_of_slab;
+        for(const Allocation<Fake> &allocation : allocations)
+        {
+            const uint64_t region = (uint64_t)(uint32_t)(allocation.x >> Pool::region_shift) << 32
+                | (uint32_t)(allocation.y >> Pool::region_shift);
+            const uintptr_t addr = (uintptr_t)allocation.fake;
+            const uintptr_t slab = addr / Pool::arena_size * Pool::arena_slabs + addr % Pool::arena_size / Pool::slab_size;
+            slabs_of_region[region].insert(slab);
+            regions_of_slab[slab].insert(region);
+        }
+        bool shared = true;
+        for(const auto &slab : regions_of_slab)
+            shared = shared && slab.second.size() == 1;
+        const size_t region_area = (size_t)1 << (2 * Pool::region_shift);
+        const size_t slabs_needed = (region_area + Pool::slab_slots - 1) / Pool::slab_slots;
+        for(const auto &region : slabs_of_region)
+            shared = shared && region.second.size() <= slabs_needed;
+        check(shared, "a region keeps to as few slabs as it fills" + what);
+
+        // a hole in a full slab goes to the next chunk of the same region, x is even so x + 1 is in it
+        pool.free(allocations[4].fake);
+        check(pool.allocate(allocations[4].x + 1, allocations[4].y) == allocations[4].fake, "holes are reused" + what);
+    }
+    {
+        Pool pool(0);
+        const std::vector<Allocation<Fake>> allocations = allocate_square(pool, 40);
+        for(const Allocation<Fake> &allocation : allocations)
+            pool.free(allocation.fake);
+        check(pool.dead_count() == 0, "empty slabs given back past the dead limit" + what);
+        // given back pages come back zeroed, the patterns still being there would mean they were kept
+        bool zeroed = true;
+        for(const Allocation<Fake> &allocation : allocations)
+        {
+            const Fake *fake = (const Fake*)pool.allocate(allocation.x, allocation.y);
+            for(const uint64_t word : fake->words)
+                zeroed = zeroed && word == 0;
+        }
+        check(zeroed, "given back slabs are really released" + what);
+    }
+    {
+        Pool pool(1 << 20);
+        const std::vector<Allocation<Fake>> allocations = allocate_square(pool, 40);
+        for(const Allocation<Fake> &allocation : allocations)
+            pool.free(allocation.fake);
+        check(pool.dead_count() >= allocations.size(), "slabs kept under the dead limit" + what);
+        pool.set_dead_limit(0);
+        check(pool.dead_count() == 0, "set_dead_limit gives them back" + what);
+    }
+}
+
+// What an arena loses to the slabs not dividing it, the pair of 128 cell chunks used to lose almost half
+template<class T>
+void check_arena_use(const std::string &name)
+{
+    typedef ChunkPool<T> Pool;
+    const size_t used = Pool::arena_slabs * Pool::slab_size;
+    check(used >= Pool::arena_size / 8 * 7, name + " use " + std::to_string(used * 100 / Pool::arena_size) + "% of an arena in "
+        + std::to_string(Pool::arena_slabs) + " slabs");
+}
+
+int main()
+{
+    check_pool<Fake<64>>("small chunks", 96);
+    // a few slots a slab, less than a word of the free mask
+    check_pool<Fake<5000>>("big chunks", 24);
+
+    check_arena_use<ChunkPair<BasicBoolChunk<5>>>("32 cell chunk pairs");
+    check_arena_use<ChunkPair<BasicBoolChunk<6>>>("64 cell chunk pairs");
+    check_arena_use<ChunkPair<BasicBoolChunk<7>>>("128 cell chunk pairs");
+    check_arena_use<ChunkPair<BasicBoolChunk<8>>>("256 cell chunk pairs");
+    return test_result();
+}
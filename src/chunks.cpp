@@ -1,9 +1,17 @@
+#pragma once
 #include <stdlib.h>
-#include <unordered_map>
+#include <stdint.h>
 #include <cstring> // for memset
 #include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <climits>
 
 #include <vects.hpp>
+#include <chunk_map.hpp>
+#include <chunk_pool.hpp>
+#include <profile.hpp>
+#include <rule.hpp>
 
 inline void set_bit(unsigned char &byte, const int offset, const bool val) 
 {
@@ -31,20 +39,83 @@ public:
     virtual void set(const Vect2i &pos, bool val) = 0;
 };
 
-class BoolChunk : public BoolGrid2D
+struct CellBox
 {
+    // Cells from (min_x, min_y) to (max_x, max_y), both included, empty while min_x > max_x
+    int min_x = INT_MAX, min_y = INT_MAX, max_x = INT_MIN, max_y = INT_MIN;
+
+    bool empty() const
+    {
+        return min_x > max_x;
+    }
+
+    // Grows to cover other too
+    void add(const CellBox &other)
+    {
+        min_x = std::min(min_x, other.min_x);
+        min_y = std::min(min_y, other.min_y);
+        max_x = std::max(max_x, other.max_x);
+        max_y = std::max(max_y, other.max_y);
+    }
+};
+
+template<int Shift>
+class BasicBoolChunk final : public BoolGrid2D
+{
+    /**
+     * @brief Packed square of side_len_b cells, row by row, bit x of a row is cell x
+     * Rows are worked on in words, one per row up to 64 cells, more for the wider chunks.
+     */
 public:
-    static const int side_len_b = 1 << 5; // 32 rows or 4 octets
-    static const int chunk_size_b = side_len_b * side_len_b; //1024b, 1/32 page size
+    static const int side_shift = Shift;
+    static const int side_len_b = 1 << side_shift; // 32, 64, 128 or 256 cells
+    static const int chunk_size_b = side_len_b * side_len_b; // 1024b for 32, 1/32 page size
     static const int chunk_size = chunk_size_b / 8;
     static const int side_len = side_len_b / 8;
+    typedef typename std::conditional<side_shift == 5, uint32_t, uint64_t>::type Word;
+    static const int word_bits = sizeof(Word) * 8;
+    static const int row_words = side_len_b / word_bits;
+    static_assert(side_shift >= 5 && side_shift <= 8, "Chunk side must be 32, 64, 128 or 256");
     int live_cells;
+    uint8_t min_x = 0, min_y = 0, max_x = 0, max_y = 0; // box around the live cells, if there are any
 private:
+    static inline bool any_word(const Word *row)
+    {
+        Word any = 0;
+        for(int w = 0; w < row_words; w++)
+            any |= row[w];
+        return any != 0;
+    }
+
+    // Box from the OR of all rows (per word) and the first and last row with anything
+    inline void set_box(const Word *columns, const int top, const int bottom)
+    {
+        if(bottom < 0)
+            return;
+        min_y = top;
+        max_y = bottom;
+        for(int w = 0; w < row_words; w++)
+        {
+            if(columns[w])
+            {
+                min_x = w * word_bits + __builtin_ctzll(columns[w]);
+                break;
+            }
+        }
+        for(int w = row_words - 1; w >= 0; w--)
+        {
+            if(columns[w])
+            {
+                max_x = w * word_bits + 63 - __builtin_clzll(columns[w]);
+                break;
+            }
+        }
+    }
 
 public:
     unsigned char bytes[chunk_size];
 
-    BoolChunk()
+    BasicBoolChunk()
     {
         // wipe with 0s
         live_cells = 0;
@@ -66,269 +137,869 @@ public:
         unsigned char *byte = &bytes[(pos.x >> 3) + pos.y * side_len];
         if(get_bit(*byte, pos.x & (8 - 1)) ^ val)
         {
-            if(val)
-                live_cells++;
-            else
-                live_cells--;
             set_bit(*byte, pos.x & (8 - 1), val);
+            if(val)
+            {
+                if(live_cells++ == 0)
+                {
+                    min_x = max_x = pos.x;
+                    min_y = max_y = pos.y;
+                    return;
+                }
+                min_x = std::min<int>(min_x, pos.x);
+                max_x = std::max<int>(max_x, pos.x);
+                min_y = std::min<int>(min_y, pos.y);
+                max_y = std::max<int>(max_y, pos.y);
+            }
+            else if(--live_cells != 0 && (pos.x == min_x || pos.x == max_x || pos.y == min_y || pos.y == max_y))
+                find_box(); // it may have been the last cell on that edge
         }
     }
 
+    // Box of the live cells in global positions, empty if there are none
+    inline CellBox box(const Vect2i &chunk_pos) const
+    {
+        CellBox rval;
+        if(live_cells != 0)
+            rval = {chunk_pos.x + min_x, chunk_pos.y + min_y, chunk_pos.x + max_x, chunk_pos.y + max_y};
+        return rval;
+    }
+
+    // Works the box out again from the rows, for when they were written without set_rows()
+    void find_box()
+    {
+        Word columns[row_words] = {};
+        int top = side_len_b, bottom = -1;
+        for(int y = 0; y < side_len_b; y++)
+        {
+            Word any = 0;
+            for(int w = 0; w < row_words; w++)
+            {
+                const Word word = get_word(y, w);
+                columns[w] |= word;
+                any |= word;
+            }
+            if(any)
+            {
+                top = std::min(top, y);
+                bottom = y;
+            }
+        }
+        set_box(columns, top, bottom);
+    }
+
     inline void clear()
     {
         live_cells = 0;
         memset(bytes, 0, sizeof(bytes));
     }
-};
 
-class UnpackedBoolChunk : public BoolGrid2D
-{
-public:
-    static const int side_len = BoolChunk::side_len_b;
+    // Word w of row y, bit i is cell w * word_bits + i
+    inline Word get_word(const int y, const int w) const
+    {
+        Word val;
+        memcpy(&val, &bytes[y * side_len + w * sizeof(Word)], sizeof(val));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        val = sizeof(Word) == 4 ? __builtin_bswap32(val) : __builtin_bswap64(val);
+#endif
+        return val;
+    }
 
-private:
-    bool cells[side_len][side_len];
+    // Does not update live_cells
+    inline void set_word(const int y, const int w, Word val)
+    {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        val = sizeof(Word) == 4 ? __builtin_bswap32(val) : __builtin_bswap64(val);
+#endif
+        memcpy(&bytes[y * side_len + w * sizeof(Word)], &val, sizeof(val));
+    }
 
-public:
-    int live_cells;
-    UnpackedBoolChunk()
+    // Packed row, bit x is cell x, for chunks with one word rows
+    inline Word get_row(const int y) const
     {
-        // wipe with 0s
-        live_cells = 0;
-        memset(cells, 0, sizeof(cells));
+        static_assert(row_words == 1, "Rows are more than a word, use get_word()");
+        return get_word(y, 0);
     }
 
-    bool get(const Vect2i &pos) const override
+    // Does not update live_cells
+    inline void set_row(const int y, const Word val)
     {
-        return cells[pos.x][pos.y];
+        static_assert(row_words == 1, "Rows are more than a word, use set_word()");
+        set_word(y, 0, val);
     }
 
-    void set(const Vect2i &pos, bool val) override
+    // rows holds row_words words per row, row after row. The box comes out of the same pass
+    inline void set_rows(const Word *rows, const int live_cells)
     {
-        if(cells[pos.x][pos.y] ^ val)
+        update_rows(rows, live_cells);
+    }
+
+    // set_rows(), but also tells if any cell differs from before
+    inline bool update_rows(const Word *rows, const int live_cells)
+    {
+        Word diff = 0;
+        Word columns[row_words] = {};
+        for(int y = 0; y < side_len_b; y++)
         {
-            if(val)
-                live_cells++;
-            else
-                live_cells--;
-            cells[pos.x][pos.y] = val;
+            for(int w = 0; w < row_words; w++)
+            {
+                const Word word = rows[y * row_words + w];
+                diff |= get_word(y, w) ^ word;
+                set_word(y, w, word);
+                columns[w] |= word;
+            }
+        }
+        this->live_cells = live_cells;
+        if(live_cells != 0)
+        {
+            // kept out of the loop above so that stays a straight copy
+            int top = 0, bottom = side_len_b - 1;
+            while(!any_word(rows + top * row_words))
+                top++;
+            while(!any_word(rows + bottom * row_words))
+                bottom--;
+            set_box(columns, top, bottom);
         }
+        return diff != 0;
+    }
+};
+
+typedef BasicBoolChunk<5> BoolChunk;
+
+struct LifeCensus
+{
+    /**
+     * @brief Live cells, chunks with any, and the box around them, of one generation buffer
+     * The loader keeps one per buffer up to date as chunks change, so the queries never walk the chunks.
+     * The ticks count what they change into one of their own and add it at the end.
+     */
+    int64_t population = 0;
+    int64_t live_chunks = 0;
+    CellBox box;
+    bool box_stale = false; // a chunk on the edge of box lost cells there, the box may be too big until counted again
+
+    // Counts a chunk going from before_live cells in before to after_live in after. edges is the box of the
+    // whole buffer before the changes, only chunks that were on it can shrink it.
+    inline void change(const CellBox &edges, const int before_live, const CellBox &before, const int after_live,
+        const CellBox &after)
+    {
+        population += after_live - before_live;
+        live_chunks += (after_live != 0) - (before_live != 0);
+        if(before_live != 0 && ((before.min_x == edges.min_x && after.min_x > before.min_x)
+            || (before.min_y == edges.min_y && after.min_y > before.min_y)
+            || (before.max_x == edges.max_x && after.max_x < before.max_x)
+            || (before.max_y == edges.max_y && after.max_y < before.max_y)))
+            box_stale = true;
+        box.add(after);
+    }
+
+    // Adds what another census counted as changes
+    inline void add(const LifeCensus &delta)
+    {
+        population += delta.population;
+        live_chunks += delta.live_chunks;
+        box.add(delta.box);
+        box_stale |= delta.box_stale;
+    }
+};
+
+template<class Chunk>
+class ChunkPair
+{
+    /**
+     * @brief Both generations of a chunk side by side, the current one is picked by the loader parity
+     * changed is 0 once the current generation equals the one two ticks back, so with the whole
+     * neighbourhood unchanged the next generation is the other buffer already and the tick can skip it.
+     * Edits set it to 2, the edited cells are not what the rule made from the neighbours, so the chunk
+     * itself has to be computed for two ticks before its other buffer can be trusted again.
+     * neighbours are kept up to date by the loader, so the tick never has to look chunks up in the map.
+     */
+public:
+    static const int edited = 2;
+    Chunk gen[2];
+    int changed = 1;
+    Vect2i pos; // of the chunk, for the code that only has the pair
+    ChunkPair *neighbours[9] = {}; // (dx + 1) * 3 + dy + 1, null if not loaded, [4] is this one
+
+    // Writes a computed generation into buffer next, updates changed and counts the change into census,
+    // edges being the box of buffer next before the tick
+    inline void store(const int next, const typename Chunk::Word *rows, const int live_cells, LifeCensus &census,
+        const CellBox &edges)
+    {
+        Chunk &chunk = gen[next];
+        const int before_live = chunk.live_cells;
+        const CellBox before = chunk.box(pos);
+        const bool differs = chunk.update_rows(rows, live_cells);
+        changed = std::max<int>(differs, changed - 1);
+        if(differs)
+            census.change(edges, before_live, before, live_cells, chunk.box(pos));
     }
 };
 
-class BoolChunkLoader : public BoolGrid2D
+typedef ChunkPair<BoolChunk> DoubleBoolChunk;
+
+// How write_region() combines the bitmap with the cells already there
+enum class BlitMode
+{
+    overwrite, // cells outside the bitmap's 1s are cleared
+    merge // 1s are ORed in, the rest is kept
+};
+
+// Up to 64 bits of a packed bitmap row starting at any bit
+inline uint64_t extract_bits(const uint64_t *row, const int64_t bit, const int len)
+{
+    const int64_t word = bit >> 6;
+    const int shift = bit & 63;
+    uint64_t bits = row[word] >> shift;
+    if(shift && shift + len > 64)
+        bits |= row[word + 1] << (64 - shift);
+    return len == 64 ? bits : bits & (((uint64_t)1 << len) - 1);
+}
+
+// ORs len bits into a packed bitmap row at any bit
+inline void deposit_bits(uint64_t *row, const int64_t bit, const uint64_t bits, const int len)
 {
+    const int64_t word = bit >> 6;
+    const int shift = bit & 63;
+    row[word] |= bits << shift;
+    if(shift && shift + len > 64)
+        row[word + 1] |= bits >> (64 - shift);
+}
+
+template<class Chunk>
+class ChunkLoader
+{
+    /**
+     * @brief The chunked universe itself, statically typed so get()/set() and the chunk accessors inline
+     * Nothing here is virtual, BoolChunkLoader puts the BoolGrid2D interface on top for the code that needs it.
+     */
+public:
+    typedef ChunkPair<Chunk> Pair;
+
 private:
-    mutable std::unordered_map<Vect2i, BoolChunk*> chunks;
-    mutable std::vector<BoolChunk*> dead;
+    ChunkPool<Pair> pool;
+    FlatPtrMap<Pair> chunks;
+    int parity = 0; // which buffer of each pair holds the current generation
+    int full_ticks = 0; // ticks left that must not skip unchanged chunks
+    int tick_generations = 1; // how far the last tick went, see set_tick_generations()
+    LifeRule life_rule;
+    mutable LifeCensus census[2]; // of each buffer, see population()
+    mutable bool handed_out[2] = {}; // chunks of the buffer were written through load_chunk(), the census is unknown
     mutable Vect2i hot_pos[2];
-    mutable BoolChunk* hot_pointer[2];
+    mutable Pair* hot_pointer[2];
     mutable int hot_iter = 0;
-    inline BoolChunk* allocate_chunk()
+    // Chunk positions are multiples of the side, so the key is just both chunk indices packed
+    static inline uint64_t chunk_key(const Vect2i &chunk_pos)
+    {
+        return (uint64_t)(uint32_t)(chunk_pos.x >> Chunk::side_shift) << 32 | (uint32_t)(chunk_pos.y >> Chunk::side_shift);
+    }
+    static inline Vect2i key_pos(const uint64_t key)
     {
-        if (!dead.empty())
+        return {(int32_t)(key >> 32) * Chunk::side_len_b, (int32_t)(uint32_t)key * Chunk::side_len_b};
+    }
+
+    // Allocates, adds to the map and links up with the neighbours
+    Pair* add_chunk(const Vect2i &chunk_pos)
+    {
+        static const int side = Chunk::side_len_b;
+        PROFILE_SCOPE(alloc);
+        PROFILE_COUNT(allocs, 1);
+        void *memory = pool.allocate(chunk_pos.x >> Chunk::side_shift, chunk_pos.y >> Chunk::side_shift);
+        Pair *chunk = new (memory) Pair();
+        chunk->pos = chunk_pos;
+        chunks.insert(chunk_key(chunk_pos), chunk);
+        Vect2i positions[9];
+        for(int i = 0; i < 9; i++)
+            positions[i] = {chunk_pos.x + (i / 3 - 1) * side, chunk_pos.y + (i % 3 - 1) * side};
+        find_pairs(positions, chunk->neighbours, 9);
+        for(int i = 0; i < 9; i++)
         {
-            BoolChunk* chunk = dead.back();
-            dead.pop_back();
-            chunk->live_cells = 0;
-            return chunk;
+            if(chunk->neighbours[i])
+                chunk->neighbours[i]->neighbours[8 - i] = chunk; // opposite direction
         }
-        else
+        return chunk;
+    }
+
+    // Unlinks from the neighbours and frees, the map entry has to be removed by the caller
+    inline void free_chunk(Pair *chunk)
+    {
+        PROFILE_COUNT(frees, 1);
+        for(int i = 0; i < 9; i++)
         {
-            BoolChunk* chunk = new BoolChunk();
-            return chunk;
+            if(chunk->neighbours[i])
+                chunk->neighbours[i]->neighbours[8 - i] = nullptr;
+        }
+        chunk->~Pair();
+        pool.free(chunk);
+    }
+
+    // Counts again from the chunk boxes, or the rows too if chunks were handed out
+    void recount(const int buffer) const
+    {
+        PROFILE_SCOPE(recount);
+        LifeCensus fresh;
+        for(auto iter = chunks.begin(); iter != chunks.end(); ++iter)
+        {
+            Chunk &chunk = iter->value->gen[buffer];
+            if(chunk.live_cells == 0)
+                continue;
+            if(handed_out[buffer])
+                chunk.find_box();
+            fresh.population += chunk.live_cells;
+            fresh.live_chunks++;
+            fresh.box.add(chunk.box(iter->value->pos));
         }
+        census[buffer] = fresh;
+        handed_out[buffer] = false;
+    }
+
+    // Census of the current generation, counted again first if it is not known. The box may still be stale
+    const LifeCensus& current_census() const
+    {
+        if(handed_out[parity])
+            recount(parity);
+        return census[parity];
+    }
+
+    // Shrinks a stale box back around the chunk boxes, the counts are right already
+    void refit_box(const int buffer) const
+    {
+        PROFILE_SCOPE(recount);
+        CellBox box;
+        for(auto iter = chunks.begin(); iter != chunks.end(); ++iter)
+        {
+            const Chunk &chunk = iter->value->gen[buffer];
+            if(chunk.live_cells != 0)
+                box.add(chunk.box(iter->value->pos));
+        }
+        census[buffer].box = box;
+        census[buffer].box_stale = false;
+    }
+
+    inline void set_cell(Pair *pair, const Vect2i &local_pos, const bool val)
+    {
+        Chunk &chunk = pair->gen[parity];
+        const int before_live = chunk.live_cells;
+        const CellBox before = chunk.box(pair->pos);
+        chunk.set(local_pos, val);
+        pair->changed = Pair::edited;
+        if(chunk.live_cells != before_live)
+            census[parity].change(census[parity].box, before_live, before, chunk.live_cells, chunk.box(pair->pos));
     }
 public:
-    BoolChunkLoader()
+    // dead_limit is how many unused chunks are kept around before memory goes back to the os
+    ChunkLoader(size_t dead_limit = 1 << 16, bool huge_pages = false) : pool(dead_limit, huge_pages)
     {
-        hot_pointer[0] = new BoolChunk();
+        hot_pointer[0] = add_chunk({0, 0});
         hot_pointer[1] = hot_pointer[0];
         hot_pos[0] = Vect2i();
         hot_pos[1] = hot_pos[0];
-        chunks.insert({{0,0},hot_pointer[0]});
     }
 
     // Very slow, use bulk instead
-    bool get(const Vect2i &pos) const override
+    inline bool get(const Vect2i &pos) const
     {
-        Vect2i local_pos = {pos.x % BoolChunk::side_len_b, pos.y % BoolChunk::side_len_b};
+        Vect2i local_pos = {pos.x % Chunk::side_len_b, pos.y % Chunk::side_len_b};
         if(local_pos.x < 0)
-            local_pos.x += BoolChunk::side_len_b;
+            local_pos.x += Chunk::side_len_b;
         if(local_pos.y < 0)
-            local_pos.y += BoolChunk::side_len_b;
+            local_pos.y += Chunk::side_len_b;
         Vect2i chunk_pos = pos - local_pos;
         if(chunk_pos == hot_pos[0])
-            return hot_pointer[0]->get(local_pos);
+        {
+            PROFILE_COUNT(hot_hit, 1);
+            return hot_pointer[0]->gen[parity].get(local_pos);
+        }
         if(chunk_pos == hot_pos[1])
-            return hot_pointer[1]->get(local_pos);
-        BoolChunk* chunk;
-        auto querry = chunks.find(chunk_pos);
-        if (querry == chunks.end())
+        {
+            PROFILE_COUNT(hot_hit, 1);
+            return hot_pointer[1]->gen[parity].get(local_pos);
+        }
+        PROFILE_COUNT(hot_miss, 1);
+        PROFILE_COUNT(lookups, 1);
+        Pair* chunk = chunks.find(chunk_key(chunk_pos));
+        if (!chunk)
             return 0;
         else
         {
             hot_iter = !hot_iter;
-            hot_pos[hot_iter] = querry->first;
-            hot_pointer[hot_iter] = querry->second;
-            return querry->second->get(local_pos);
+            hot_pos[hot_iter] = chunk_pos;
+            hot_pointer[hot_iter] = chunk;
+            return chunk->gen[parity].get(local_pos);
         }
     }
 
     // Very slow, use bulk instead
-    void set(const Vect2i &pos, bool val) override
+    inline void set(const Vect2i &pos, bool val)
     {
-        Vect2i local_pos = {pos.x % BoolChunk::side_len_b, pos.y % BoolChunk::side_len_b};
+        Vect2i local_pos = {pos.x % Chunk::side_len_b, pos.y % Chunk::side_len_b};
         if(local_pos.x < 0)
-            local_pos.x += BoolChunk::side_len_b;
+            local_pos.x += Chunk::side_len_b;
         if(local_pos.y < 0)
-            local_pos.y += BoolChunk::side_len_b;
+            local_pos.y += Chunk::side_len_b;
         Vect2i chunk_pos = pos - local_pos;
         if(chunk_pos == hot_pos[0])
         {
-            hot_pointer[0]->set(local_pos, val);
+            set_cell(hot_pointer[0], local_pos, val);
             return;
         }
         if(chunk_pos == hot_pos[1])
         {
-            hot_pointer[1]->set(local_pos, val);
+            set_cell(hot_pointer[1], local_pos, val);
             return;
         }
-        BoolChunk* chunk;
-        auto querry = chunks.find(chunk_pos);
-        if (querry == chunks.end())
+        Pair* chunk = chunks.find(chunk_key(chunk_pos));
+        if (!chunk)
         {
             if(val == 0) // lazy loading not broken by set(0)
                 return;
-            chunk = allocate_chunk();
-            chunks.insert({chunk_pos, chunk});
+            chunk = add_chunk(chunk_pos);
         }
-        else
-            chunk = querry->second;
-        chunk->set(local_pos, val);
+        set_cell(chunk, local_pos, val);
     }
 
-    UnpackedBoolChunk get_unpacked_chunk(const Vect2i &chunk_pos) const
+    // Current generation buffer
+    // No hot cache, so safe to call on a loader that is only being read
+    const Chunk* find_chunk(const Vect2i &chunk_pos) const
     {
-        UnpackedBoolChunk rval;
-        auto querry = chunks.find(chunk_pos);
-        if (querry == chunks.end())
-            return rval;
-        const BoolChunk& chunk = *querry->second;
-        for(int y = 0; y < BoolChunk::side_len_b; y++)
+        const Pair* chunk = chunks.find(chunk_key(chunk_pos));
+        return chunk ? &chunk->gen[parity] : nullptr;
+    }
+
+    // find_chunk() for n chunks at once, cheaper than one by one
+    void find_chunks(const Vect2i *chunk_pos, const Chunk **found, const int n) const
+    {
+        static const int batch = 16;
+        uint64_t keys[batch];
+        Pair *pairs[batch];
+        for(int i = 0; i < n; i += batch)
         {
-            for(int x = 0; x < BoolChunk::side_len; x++)
-            {
-                unsigned char byte = chunk.bytes[x + y * BoolChunk::side_len];
-                for(int i = 0; i < 8; i++)
-                {
-                    rval.set({x*8+i,y},byte & 1);
-                    byte = byte >> 1;
-                }
-            }
+            const int len = std::min(batch, n - i);
+            for(int j = 0; j < len; j++)
+                keys[j] = chunk_key(chunk_pos[i + j]);
+            chunks.find(keys, pairs, len);
+            PROFILE_COUNT(lookups, len);
+            for(int j = 0; j < len; j++)
+                found[i + j] = pairs[j] ? &pairs[j]->gen[parity] : nullptr;
         }
-        return rval;
     }
 
-    void set_unpacked_chunk(const Vect2i &chunk_pos, const UnpackedBoolChunk &uchunk)
+    // Both buffers of n chunks at once, null for missing ones
+    void find_pairs(const Vect2i *chunk_pos, Pair **found, const int n)
     {
-        BoolChunk* chunk_p;
-        if (chunk_pos == hot_pos[0])
-            chunk_p = hot_pointer[0];
-        else if (chunk_pos == hot_pos[1])
-            chunk_p = hot_pointer[1];
-        else 
+        static const int batch = 16;
+        uint64_t keys[batch];
+        for(int i = 0; i < n; i += batch)
         {
-            auto querry = chunks.find(chunk_pos);
-            if (querry == chunks.end())
-            {
-                chunk_p = allocate_chunk();
-                chunks.insert({chunk_pos, chunk_p});
-            }
-            else
-                chunk_p = querry->second;
+            const int len = std::min(batch, n - i);
+            for(int j = 0; j < len; j++)
+                keys[j] = chunk_key(chunk_pos[i + j]);
+            chunks.find(keys, found + i, len);
+            PROFILE_COUNT(lookups, len);
         }
-        BoolChunk& chunk = *chunk_p;
-        if(uchunk.live_cells == 0 && chunk.live_cells == 0) // im unsure how to hash chunk state
-            return; // this optimization bellow sucks. // removed it
-        else
-            chunk.live_cells = uchunk.live_cells;
-        for(int y = 0; y < BoolChunk::side_len_b; y++)
+    }
+
+    // Gets both buffers of the chunk, allocating it if needed
+    Pair* load_pair(const Vect2i &chunk_pos)
+    {
+        const uint64_t key = chunk_key(chunk_pos);
+        Pair* chunk = chunks.find(key);
+        if (chunk)
+            return chunk;
+        return add_chunk(chunk_pos);
+    }
+
+    // Gets the current generation of the chunk for writing, allocating it if needed.
+    // The writer keeps live_cells right, the box and census are worked out again on the next query.
+    Chunk* load_chunk(const Vect2i &chunk_pos)
+    {
+        Pair* chunk = load_pair(chunk_pos);
+        chunk->changed = Pair::edited;
+        handed_out[parity] = true;
+        return &chunk->gen[parity];
+    }
+
+    // Loaded chunks, some may be empty until the next cull()
+    size_t chunk_count() const
+    {
+        return chunks.size();
+    }
+
+    // Live cells of the current generation. Like live_chunk_count() it is kept up to date as cells change, so it is
+    // O(1), unless chunks were written through load_chunk(), then the chunks are counted again once
+    int64_t population() const
+    {
+        return current_census().population;
+    }
+
+    // Chunks of the current generation with live cells
+    int64_t live_chunk_count() const
+    {
+        return current_census().live_chunks;
+    }
+
+    // Smallest box around the live cells of the current generation, empty if there are none.
+    // O(1) while the box only grows, it is worked out again from the chunks after cells went from its edge
+    CellBox bounding_box() const
+    {
+        current_census();
+        if(census[parity].box_stale)
+            refit_box(parity);
+        return census[parity].box;
+    }
+
+    // Box of buffer before a tick writes it, what ChunkPair::store() wants as edges
+    const CellBox& census_edges(const int buffer) const
+    {
+        return census[buffer].box;
+    }
+
+    // Adds the changes a tick counted while writing buffer
+    void add_census(const int buffer, const LifeCensus &delta)
+    {
+        census[buffer].add(delta);
+    }
+
+    // Index of the current generation in each pair, the tick writes the other one
+    int current() const
+    {
+        return parity;
+    }
+
+    // Makes the buffers written by the tick current
+    void flip()
+    {
+        parity = !parity;
+        if(full_ticks > 0)
+            full_ticks--;
+    }
+
+    // What the tick runs, Life unless set
+    const LifeRule& rule() const
+    {
+        return life_rule;
+    }
+
+    void set_rule(const LifeRule &rule)
+    {
+        if(rule == life_rule)
+            return;
+        life_rule = rule;
+        full_ticks = 2; // the other buffers are from the old rule
+    }
+
+    // How many generations each tick advances, ticks call it first. The other buffer then holds the generation
+    // that many back, and skipping a chunk takes it as the next one, so a different count forces two full ticks.
+    void set_tick_generations(const int generations)
+    {
+        if(generations == tick_generations)
+            return;
+        tick_generations = generations;
+        full_ticks = 2;
+    }
+
+    // False for two ticks after chunks were dropped with live cells in them or the rule or tick length changed,
+    // the other buffers were computed from cells or a rule that are gone now
+    bool skipping_allowed() const
+    {
+        return full_ticks == 0;
+    }
+
+    // Calls fn(chunk_pos, pair) for every chunk, must not add or remove chunks
+    template<class Fn>
+    void for_each_pair(Fn fn)
+    {
+        for(auto iter = chunks.begin(); iter != chunks.end(); ++iter)
+            fn(key_pos(iter->key), *iter->value);
+    }
+
+    // One chunk of a ChunkRange
+    struct ChunkRef
+    {
+        const Vect2i &pos;
+        const Chunk &chunk;
+    };
+
+    class ChunkRange
+    {
+        /**
+         * @brief The current generation of every loaded chunk, straight out of the map, nothing is copied
+         * for(const auto entry : life.loaded_chunks()) gives entry.pos and entry.chunk. Chunks must not be
+         * added or removed while going through it, set() of a live cell and the ticks may do that.
+         */
+        typedef typename FlatPtrMap<Pair>::const_iterator MapIter;
+        MapIter first, last;
+        int cur;
+        size_t count;
+
+    public:
+        class iterator
         {
-            for(int x = 0; x < BoolChunk::side_len; x++)
+            MapIter iter;
+            int cur;
+        public:
+            iterator(const MapIter &iter, const int cur) : iter(iter), cur(cur)
             {
-                unsigned char byte = 0;
-                for(int i = 0; i < 8; i++)
-                {
-                    byte |= uchunk.get({x*8+i, y}) << i; // endiannes matters
-                }
-                chunk.bytes[x + y * BoolChunk::side_len] = byte;
             }
+            ChunkRef operator*() const
+            {
+                return {iter->value->pos, iter->value->gen[cur]};
+            }
+            iterator& operator++()
+            {
+                ++iter;
+                return *this;
+            }
+            bool operator!=(const iterator &other) const
+            {
+                return iter != other.iter;
+            }
+        };
+
+        ChunkRange(const MapIter &first, const MapIter &last, const int cur, const size_t count)
+            : first(first), last(last), cur(cur), count(count)
+        {
         }
-    }
+        iterator begin() const
+        {
+            return iterator(first, cur);
+        }
+        iterator end() const
+        {
+            return iterator(last, cur);
+        }
+        size_t size() const
+        {
+            return count;
+        }
+    };
 
-    std::unordered_map<Vect2i, BoolChunk*> getChunkMap()
+    ChunkRange loaded_chunks() const
     {
-        return chunks;
+        return ChunkRange(chunks.begin(), chunks.end(), parity, chunks.size());
     }
 
+    // Drops chunks that have been empty for the last three generations,
+    // so a missing chunk can always be taken as unchanged
     void cull()
     {
-        for(auto iter = chunks.begin(); iter != chunks.end(); )
+        PROFILE_SCOPE(cull);
+        const uint64_t origin = chunk_key({0, 0});
+        chunks.erase_if([&](const typename FlatPtrMap<Pair>::Slot &slot)
         {
-            if(iter->first == Vect2i(0, 0))
+            if(slot.key == origin)
             {
-                hot_pointer[0] = iter->second;
+                hot_pointer[0] = slot.value;
                 hot_pointer[1] = hot_pointer[0];
                 hot_pos[0] = Vect2i(0, 0);
                 hot_pos[1] = hot_pos[0];
+                return false;
             }
-            if(iter->second->live_cells == 0)
-            {
-                auto to_delete = iter++;
-                dead.push_back(to_delete->second);
-                chunks.erase(to_delete);
-            }
-            else
-                ++iter;
-        }
+            const Pair &pair = *slot.value;
+            if(pair.changed || pair.gen[0].live_cells != 0 || pair.gen[1].live_cells != 0)
+                return false;
+            free_chunk(slot.value);
+            return true;
+        });
+    }
+
+    // Empties the current generation of a chunk but keeps it loaded. Unlike kill() skipping stays on,
+    // the chunk is recomputed like any edited one
+    void clear_chunk(const Vect2i &chunk_pos)
+    {
+        Pair* pair = chunks.find(chunk_key(chunk_pos));
+        if(!pair || pair->gen[parity].live_cells == 0)
+            return;
+        Chunk &chunk = pair->gen[parity];
+        census[parity].change(census[parity].box, chunk.live_cells, chunk.box(chunk_pos), 0, CellBox());
+        chunk.clear();
+        pair->changed = Pair::edited;
     }
 
     void kill(const Vect2i &chunk_pos)
     {
         if(chunk_pos == Vect2i(0, 0))
             return;
-        auto querry = chunks.find(chunk_pos);
-        if(querry != chunks.end())
+        Pair* chunk = chunks.erase(chunk_key(chunk_pos));
+        if(chunk)
         {
-            BoolChunk &chunk = *querry->second;
-            if(hot_pointer[0] == &chunk)
+            for(int b = 0; b < 2; b++)
+                census[b].change(census[b].box, chunk->gen[b].live_cells, chunk->gen[b].box(chunk_pos), 0, CellBox());
+            if(hot_pointer[0] == chunk)
             {
                 hot_pos[0] = Vect2i(0, 0);
-                hot_pointer[0] = chunks.at({0, 0});
+                hot_pointer[0] = chunks.find(chunk_key({0, 0}));
             }
-            if(hot_pointer[1] == &chunk)
+            if(hot_pointer[1] == chunk)
             {
                 hot_pos[1] = Vect2i(0, 0);
-                hot_pointer[1] = chunks.at({0, 0});
+                hot_pointer[1] = chunks.find(chunk_key({0, 0}));
             }
-            if(chunk.live_cells != 0)
-                chunk.clear();
-            dead.push_back(&chunk);
-            chunks.erase(querry);
+            free_chunk(chunk);
+            full_ticks = 2;
         }
     }
 
+    // Kills every chunk
+    void clear()
+    {
+        const uint64_t origin = chunk_key({0, 0});
+        chunks.erase_if([&](const typename FlatPtrMap<Pair>::Slot &slot)
+        {
+            if(slot.key == origin)
+                return false;
+            free_chunk(slot.value);
+            return true;
+        });
+        hot_pointer[0] = chunks.find(origin);
+        hot_pointer[0]->gen[0].clear();
+        hot_pointer[0]->gen[1].clear();
+        hot_pointer[0]->changed = Pair::edited;
+        hot_pointer[1] = hot_pointer[0];
+        census[0] = census[1] = LifeCensus();
+        handed_out[0] = handed_out[1] = false;
+        full_ticks = 2;
+        hot_pos[0] = Vect2i(0, 0);
+        hot_pos[1] = hot_pos[0];
+    }
 
-    ~BoolChunkLoader()
+    // Copies the current generation of the width x height cells at pos into rows, a packed bitmap:
+    // row y starts at rows + y * stride (in words), cell x is bit x % 64 of word x / 64.
+    // One map lookup per chunk touched, no hot cache, so it is safe on a loader only being read.
+    void read_region(const Vect2i &pos, const int width, const int height, uint64_t *rows, const size_t stride) const
     {
-        for(auto iter = chunks.begin(); iter != chunks.end(); ++iter)
-            delete iter->second;
-        for(auto iter = dead.begin(); iter != dead.end(); ++iter)
-            delete *iter.base();
+        typedef typename Chunk::Word Word;
+        static const int side = Chunk::side_len_b;
+        static const int word_bits = Chunk::word_bits;
+        for(int y = 0; y < height; y++)
+            std::fill(rows + y * stride, rows + y * stride + (width + 63) / 64, 0);
+        const int64_t end_x = (int64_t)pos.x + width, end_y = (int64_t)pos.y + height;
+        for(int64_t chunk_y = pos.y & ~(side - 1); chunk_y < end_y; chunk_y += side)
+        {
+            const int64_t from_y = std::max<int64_t>(pos.y, chunk_y), to_y = std::min<int64_t>(end_y, chunk_y + side);
+            for(int64_t chunk_x = pos.x & ~(side - 1); chunk_x < end_x; chunk_x += side)
+            {
+                const Chunk *chunk = find_chunk({(int)chunk_x, (int)chunk_y});
+                if(!chunk || chunk->live_cells == 0)
+                    continue;
+                const int64_t from_x = std::max<int64_t>(pos.x, chunk_x), to_x = std::min<int64_t>(end_x, chunk_x + side);
+                for(int w = (from_x - chunk_x) / word_bits; w <= (to_x - 1 - chunk_x) / word_bits; w++)
+                {
+                    const int64_t word_x = chunk_x + w * word_bits;
+                    const int64_t lo = std::max(from_x, word_x), hi = std::min(to_x, word_x + word_bits);
+                    const int len = hi - lo;
+                    const Word mask = len == word_bits ? ~(Word)0 : ((Word)1 << len) - 1;
+                    for(int64_t y = from_y; y < to_y; y++)
+                    {
+                        const Word bits = (chunk->get_word(y - chunk_y, w) >> (lo - word_x)) & mask;
+                        if(bits)
+                            deposit_bits(rows + (y - pos.y) * stride, lo - pos.x, bits, len);
+                    }
+                }
+            }
+        }
+    }
+
+    // Writes a packed bitmap laid out as in read_region() into the current generation at pos.
+    // One map lookup per chunk touched, chunks are only created where there are 1s to put.
+    void write_region(const Vect2i &pos, const int width, const int height, const uint64_t *rows, const size_t stride,
+        const BlitMode mode = BlitMode::overwrite)
+    {
+        typedef typename Chunk::Word Word;
+        static const int side = Chunk::side_len_b;
+        static const int word_bits = Chunk::word_bits;
+        const int64_t end_x = (int64_t)pos.x + width, end_y = (int64_t)pos.y + height;
+        for(int64_t chunk_y = pos.y & ~(side - 1); chunk_y < end_y; chunk_y += side)
+        {
+            const int64_t from_y = std::max<int64_t>(pos.y, chunk_y), to_y = std::min<int64_t>(end_y, chunk_y + side);
+            for(int64_t chunk_x = pos.x & ~(side - 1); chunk_x < end_x; chunk_x += side)
+            {
+                const int64_t from_x = std::max<int64_t>(pos.x, chunk_x), to_x = std::min<int64_t>(end_x, chunk_x + side);
+                const int first = (from_x - chunk_x) / word_bits, last = (to_x - 1 - chunk_x) / word_bits;
+                Word bits[side][Chunk::row_words];
+                Word keep[Chunk::row_words] = {}; // only first to last are read, gcc can not tell
+                Word any = 0;
+                for(int w = first; w <= last; w++)
+                {
+                    const int64_t word_x = chunk_x + w * word_bits;
+                    const int64_t lo = std::max(from_x, word_x), hi = std::min(to_x, word_x + word_bits);
+                    const int len = hi - lo, shift = lo - word_x;
+                    keep[w] = mode == BlitMode::merge ? ~(Word)0 : ~((len == word_bits ? ~(Word)0 : ((Word)1 << len) - 1) << shift);
+                    for(int64_t y = from_y; y < to_y; y++)
+                    {
+                        bits[y - from_y][w] = (Word)extract_bits(rows + (y - pos.y) * stride, lo - pos.x, len) << shift;
+                        any |= bits[y - from_y][w];
+                    }
+                }
+                const Vect2i chunk_pos = {(int)chunk_x, (int)chunk_y};
+                Pair *pair;
+                if(any)
+                    pair = load_pair(chunk_pos);
+                else if(mode == BlitMode::merge)
+                    continue;
+                else
+                {
+                    // only clearing, nothing to do where nothing is loaded
+                    pair = chunks.find(chunk_key(chunk_pos));
+                    if(!pair || pair->gen[parity].live_cells == 0)
+                        continue;
+                }
+                pair->changed = Pair::edited;
+                Chunk *chunk = &pair->gen[parity];
+                const int before_live = chunk->live_cells;
+                const CellBox before = chunk->box(chunk_pos);
+                for(int64_t y = from_y; y < to_y; y++)
+                {
+                    for(int w = first; w <= last; w++)
+                    {
+                        const Word old_word = chunk->get_word(y - chunk_y, w);
+                        const Word new_word = (old_word & keep[w]) | bits[y - from_y][w];
+                        chunk->set_word(y - chunk_y, w, new_word);
+                        chunk->live_cells += __builtin_popcountll(new_word) - __builtin_popcountll(old_word);
+                    }
+                }
+                chunk->find_box();
+                census[parity].change(census[parity].box, before_live, before, chunk->live_cells, chunk->box(chunk_pos));
+            }
+        }
+    }
+
+    void set_dead_limit(size_t dead_limit)
+    {
+        pool.set_dead_limit(dead_limit);
+    }
+
+    size_t dead_count() const
+    {
+        return pool.dead_count();
     }
 };
 
+template<class Chunk>
+class BasicBoolChunkLoader final : public ChunkLoader<Chunk>, public BoolGrid2D
+{
+    /**
+     * @brief ChunkLoader as a BoolGrid2D, for the pattern setters and printing
+     * Calls through a BasicBoolChunkLoader itself are resolved statically, it is final.
+     */
+public:
+    BasicBoolChunkLoader(size_t dead_limit = 1 << 16, bool huge_pages = false) : ChunkLoader<Chunk>(dead_limit, huge_pages)
+    {
+    }
+
+    bool get(const Vect2i &pos) const override
+    {
+        return ChunkLoader<Chunk>::get(pos);
+    }
+
+    void set(const Vect2i &pos, bool val) override
+    {
+        ChunkLoader<Chunk>::set(pos, val);
+    }
+};
+
+typedef BasicBoolChunkLoader<BoolChunk> BoolChunkLoader;
+
 template<class Interface, class ConcreteClass>
 class Decorator : public Interface
 {
@@ -336,12 +1007,3 @@ class Decorator : public Interface
 protected:
     ConcreteClass *decorated;
 };
-
-template<class Interface, class Key, class Chunk>
-class ChunkLoader : public Interface
-{
-    static_assert(std::is_base_of<Interface, Chunk>::value, "Chunk does not conform to interface");
-    static_assert(std::is_base_of<Vect, Key>::value, "Key must be defined over a vector space");
-    mutable std::unordered_map<Key, Chunk> chunk_map;
-};
-
@@ -0,0 +1,227 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "chunks.cpp"
+#include "kernel.hpp"
+#include "thread_pool.hpp"
+
+// What is past the sides of a DenseGrid
+enum class Edge
+{
+    wrap, // the other side, a torus
+    dead, // cells that never come alive
+};
+
+class DenseGrid final : public BoolGrid2D
+{
+    /**
+     * @brief A fixed width x height board in one block of memory, no map, no chunks and no chunk edges
+     * The board is cut into strips 64 cells wide. A strip is a column of words, row after row, with a row of halo
+     * above and bellow, so a generation is a straight walk down each strip and the two beside it, with the same
+     * column kernels the blocked ticks use. Before each generation the halo rows, and the cells just past the last
+     * column, are copied from the far side for a torus or left dead.
+     */
+    static constexpr int band = 256; // rows per kernel call, column_rows is the most one takes. Whole Rows, so bands never overlap
+    static constexpr int padding = 16; // words after the bottom halo row, the kernels read and write past it
+
+    int width, height;
+    Edge edge;
+    LifeRule life_rule;
+    LifeColumnFn life_column;
+    int strips;
+    int tail; // cells in the last strip, 1 to 64
+    size_t column_len; // words per strip
+    std::vector<uint64_t> cells[2]; // strip after strip, word y + 1 of a strip is row y
+    std::vector<uint64_t> west_edge, dead_column; // what is left of strip 0, nothing
+    int cur = 0;
+
+    inline uint64_t* column(const int buffer, const int strip)
+    {
+        return cells[buffer].data() + strip * column_len;
+    }
+    inline const uint64_t* column(const int buffer, const int strip) const
+    {
+        return cells[buffer].data() + strip * column_len;
+    }
+
+    inline uint64_t tail_mask() const
+    {
+        return tail == 64 ? ~(uint64_t)0 : ((uint64_t)1 << tail) - 1;
+    }
+
+    // Board position of pos, false if it is off a board with dead edges
+    inline bool place(const Vect2i &pos, int &x, int &y) const
+    {
+        if(edge == Edge::dead)
+        {
+            x = pos.x;
+            y = pos.y;
+            return x >= 0 && x < width && y >= 0 && y < height;
+        }
+        x = ((int64_t)pos.x % width + width) % width;
+        y = ((int64_t)pos.y % height + height) % height;
+        return true;
+    }
+
+    // Halo rows, the cell right of the last column and the column left of the first, for the current buffer
+    void fill_edges()
+    {
+        const bool wrap = edge == Edge::wrap;
+        for(int s = 0; s < strips; s++)
+        {
+            uint64_t *col = column(cur, s);
+            col[0] = wrap ? col[height] : 0;
+            col[height + 1] = wrap ? col[1] : 0;
+        }
+        uint64_t *first = column(cur, 0), *last = column(cur, strips - 1);
+        if(tail < 64)
+        {
+            // cell 0 goes in bit tail, where the kernel looks for the right neighbour of the last cell
+            for(int y = 0; y < height + 2; y++)
+                last[y] = (last[y] & tail_mask()) | (wrap ? (first[y] & 1) << tail : 0);
+        }
+        if(wrap) // bit 63 is all the kernel takes from the west column
+        {
+            for(int y = 0; y < height + 2; y++)
+                west_edge[y] = last[y] << (64 - tail);
+        }
+    }
+
+    void step_band(const int task)
+    {
+        const int s = task % strips, y0 = task / strips * band;
+        const int rows = std::min(band, height - y0);
+        const uint64_t *west = s > 0 ? column(cur, s - 1) : edge == Edge::wrap ? west_edge.data() : dead_column.data();
+        const uint64_t *east = s + 1 < strips ? column(cur, s + 1)
+            : edge == Edge::wrap && tail == 64 ? column(cur, 0) : dead_column.data();
+        uint64_t *result = column(!cur, s);
+        life_column(west + y0, column(cur, s) + y0, east + y0, result + y0, 1, rows + 1, life_rule);
+        if(s == strips - 1 && tail < 64)
+        {
+            for(int y = y0 + 1; y <= y0 + rows; y++)
+                result[y] &= tail_mask();
+        }
+    }
+
+public:
+    // width x height cells, all dead
+    DenseGrid(const int width, const int height, const Edge edge = Edge::wrap, const LifeRule &rule = LifeRule())
+        : width(std::max(1, width)), height(std::max(1, height)), edge(edge), life_rule(rule),
+        life_column(life_column_kernel(rule))
+    {
+        strips = (this->width + 63) / 64;
+        tail = this->width - (strips - 1) * 64;
+        column_len = (this->height + 2 + padding + 7) / 8 * 8;
+        cells[0].assign(strips * column_len, 0);
+        cells[1].assign(strips * column_len, 0);
+        west_edge.assign(column_len, 0);
+        dead_column.assign(column_len, 0);
+    }
+
+    // Off the board positions wrap around on a torus, and are dead with dead edges
+    bool get(const Vect2i &pos) const override
+    {
+        int x, y;
+        if(!place(pos, x, y))
+            return false;
+        return column(cur, x >> 6)[y + 1] >> (x & 63) & 1;
+    }
+
+    void set(const Vect2i &pos, bool val) override
+    {
+        int x, y;
+        if(!place(pos, x, y))
+            return;
+        uint64_t &word = column(cur, x >> 6)[y + 1];
+        const uint64_t bit = (uint64_t)1 << (x & 63);
+        word = val ? word | bit : word & ~bit;
+    }
+
+    void size(int &width, int &height) const
+    {
+        width = this->width;
+        height = this->height;
+    }
+
+    const LifeRule& rule() const
+    {
+        return life_rule;
+    }
+
+    void set_rule(const LifeRule &rule)
+    {
+        life_rule = rule;
+        life_column = life_column_kernel(rule);
+    }
+
+    // Advances the whole board, over the threads of pool if there is one
+    void step(const int generations = 1, WorkStealingPool *pool = nullptr)
+    {
+        const int tasks = strips * ((height + band - 1) / band);
+        for(int i = 0; i < generations; i++)
+        {
+            fill_edges();
+            if(pool)
+            {
+                pool->parallel_for(tasks, 1, [&](size_t begin, size_t end)
+                {
+                    for(size_t task = begin; task < end; task++)
+                        step_band(task);
+                });
+            }
+            else
+            {
+                for(int task = 0; task < tasks; task++)
+                    step_band(task);
+            }
+            cur = !cur;
+        }
+    }
+
+    int64_t population() const
+    {
+        int64_t live_cells = 0;
+        for(int s = 0; s < strips; s++)
+        {
+            const uint64_t *col = column(cur, s);
+            for(int y = 1; y <= height; y++)
+                live_cells += __builtin_popcountll(col[y]);
+        }
+        return live_cells;
+    }
+
+    void clear()
+    {
+        std::fill(cells[cur].begin(), cells[cur].end(), 0);
+    }
+
+    // Replaces the board with the width x height cells of life from corner on
+    template<class Chunk>
+    void copy_from(const ChunkLoader<Chunk> &life, const Vect2i &corner)
+    {
+        std::vector<uint64_t> rows((size_t)strips * height);
+        life.read_region(corner, width, height, rows.data(), strips);
+        for(int s = 0; s < strips; s++)
+        {
+            uint64_t *col = column(cur, s);
+            for(int y = 0; y < height; y++)
+                col[y + 1] = rows[(size_t)y * strips + s];
+        }
+    }
+
+    // Writes the board into life at corner, over whatever is there
+    template<class Chunk>
+    void copy_to(ChunkLoader<Chunk> &life, const Vect2i &corner) const
+    {
+        std::vector<uint64_t> rows((size_t)strips * height);
+        for(int s = 0; s < strips; s++)
+        {
+            const uint64_t *col = column(cur, s);
+            for(int y = 0; y < height; y++)
+                rows[(size_t)y * strips + s] = col[y + 1];
+        }
+        life.write_region(corner, width, height, rows.data(), strips);
+    }
+};
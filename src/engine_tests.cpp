@@ -0,0 +1,312 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "simulation.cpp"
+#include "shard.hpp"
+#include "test_cells.hpp"
+
+// The engines against a plain stepper over a set of cells, on fixed soups and a gun, under Life and rules with and
+// without a kernel of their own. DenseGrid goes against the same stepper on a bounded board.
+//
+// engine_tests [--quick]
+//   --quick    fewer generations and only the 32 and 256 cell chunks
+
+// The obvious way, on an unbounded plane
+Cells step_reference(const Cells &cells, const LifeRule &rule)
+{
+    std::map<std::pair<int, int>, int> counts;
+    for(const auto &cell : cells)
+    {
+        counts[cell]; // so live cells with no neighbours get a look too
+        for(int dy = -1; dy <= 1; dy++)
+        {
+            for(int dx = -1; dx <= 1; dx++)
+            {
+                if(dx != 0 || dy != 0)
+                    counts[{cell.first + dx, cell.second + dy}]++;
+            }
+        }
+    }
+    Cells next;
+    for(const auto &count : counts)
+    {
+        if(rule.next(cells.count(count.first), count.second))
+            next.insert(count.first);
+    }
+    return next;
+}
+
+// The same on a width x height board, cells y * width + x, wrapping around or with dead cells past the sides
+std::vector<char> step_reference(const std::vector<char> &cells, const LifeRule &rule, const int width, const int height,
+    const Edge edge)
+{
+    std::vector<char> next(cells.size());
+    for(int y = 0; y < height; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            int sum = 0;
+            for(int dy = -1; dy <= 1; dy++)
+            {
+                for(int dx = -1; dx <= 1; dx++)
+                {
+                    int nx = x + dx, ny = y + dy;
+                    if(edge == Edge::wrap)
+                    {
+                        nx = (nx + width) % width;
+                        ny = (ny + height) % height;
+                    }
+                    else if(nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    if(dx != 0 || dy != 0)
+                        sum += cells[ny * width + nx];
+                }
+            }
+            next[y * width + x] = rule.next(cells[y * width + x], sum);
+        }
+    }
+    return next;
+}
+
+struct Case
+{
+    uint64_t seed;
+    LifeRule rule;
+    Cells start;
+    std::vector<Cells> generations; // reference, index is the generation
+};
+
+// The census queries against the cells, for the current generation of life
+template<class Chunk>
+bool census_matches(const ChunkLoader<Chunk> &life, const Cells &cells)
+{
+    CellBox box;
+    std::set<std::pair<int, int>> live_chunks;
+    for(const auto &cell : cells)
+    {
+        box.add({cell.first, cell.second, cell.first, cell.second});
+        live_chunks.insert({cell.first >> Chunk::side_shift, cell.second >> Chunk::side_shift});
+    }
+    const CellBox found = life.bounding_box();
+    return life.population() == (int64_t)cells.size() && life.live_chunk_count() == (int64_t)live_chunks.size()
+        && found.empty() == box.empty() && (box.empty() || (found.min_x == box.min_x && found.min_y == box.min_y
+        && found.max_x == box.max_x && found.max_y == box.max_y));
+}
+
+std::string name_of(const Case &c)
+{
+    return c.rule.to_string() + " seed " + std::to_string(c.seed);
+}
+
+// The tick with every kernel the cpu has, against the reference, one generation per tick and blocked, with the census
+// after every tick. Over a pool only with the kernel picked for the cpu, the threads do not change what the kernels do
+template<int Shift>
+void check_chunks(const std::vector<Case> &cases, WorkStealingPool &pool)
+{
+    typedef BasicBoolChunk<Shift> Chunk;
+    const KernelIsa picked = kernel_isa();
+    for(int isa = 0; isa < (int)KernelIsa::count; isa++)
+    {
+        if(!force_kernel_isa((KernelIsa)isa))
+            continue;
+        for(const Case &c : cases)
+        {
+            for(const bool parallel : {false, true})
+            {
+                if(parallel && (KernelIsa)isa != picked)
+                    continue;
+                // the last tick of a block that does not divide the run is a short one
+                for(const int block : {1, 3, ChunkRegion<Chunk>::pad})
+                {
+                    const int len = c.generations.size() - 1;
+                    BasicBoolChunkLoader<Chunk> life;
+                    life.set_rule(c.rule);
+                    set_cells(life, c.start);
+                    bool ok = true, census_ok = census_matches(life, c.start);
+                    for(int generation = 0; ok && generation < len;)
+                    {
+                        const int generations = std::min(block, len - generation);
+                        const int done = parallel ? tick_parallel(life, pool, generations) : tick_bitwise(life, generations);
+                        life.cull();
+                        generation += done;
+                        ok = done == generations;
+                        census_ok = census_ok && census_matches(life, c.generations[generation]);
+                    }
+                    check(ok && census_ok && cells_of(life) == c.generations[len], "chunks " + name_of(c) + " side "
+                        + std::to_string(Chunk::side_len_b) + " block " + std::to_string(block) + " "
+                        + kernel_isa_name((KernelIsa)isa) + (parallel ? " parallel" : ""));
+                }
+            }
+        }
+    }
+    force_kernel_isa(picked);
+}
+
+// DenseGrid with both edges, every kernel, serial and over the pool in turn, then back into a loader with copy_to()
+void check_dense(const std::vector<Case> &cases, WorkStealingPool &pool, const int generations)
+{
+    // odd sizes, so the last strip is partly used and the bands do not line up with the height
+    const int sizes[][2] = {{64, 64}, {100, 37}, {130, 300}};
+    const KernelIsa picked = kernel_isa();
+    for(int isa = 0; isa < (int)KernelIsa::count; isa++)
+    {
+        if(!force_kernel_isa((KernelIsa)isa))
+            continue;
+        for(const Case &c : cases)
+        {
+            for(const auto &size : sizes)
+            {
+                for(const Edge edge : {Edge::wrap, Edge::dead})
+                {
+                    const int width = size[0], height = size[1];
+                    // the soup moved onto the board, with whatever is past the sides cut off
+                    std::vector<char> expected((size_t)width * height);
+                    DenseGrid grid(width, height, edge, c.rule);
+                    for(const auto &cell : c.start)
+                    {
+                        const int x = cell.first + 24, y = cell.second + 20;
+                        if(x >= 0 && y >= 0 && x < width && y < height)
+                        {
+                            expected[y * width + x] = 1;
+                            grid.set({x, y}, 1);
+                        }
+                    }
+                    bool ok = true;
+                    for(int i = 0; ok && i < generations; i++)
+                    {
+                        expected = step_reference(expected, c.rule, width, height, edge);
+                        grid.step(1, i % 2 ? &pool : nullptr);
+                        for(int y = 0; ok && y < height; y++)
+                        {
+                            for(int x = 0; ok && x < width; x++)
+                                ok = grid.get({x, y}) == expected[y * width + x];
+                        }
+                    }
+                    Cells expected_cells;
+                    for(int y = 0; y < height; y++)
+                    {
+                        for(int x = 0; x < width; x++)
+                        {
+                            if(expected[y * width + x])
+                                expected_cells.insert({x - 24, y - 20});
+                        }
+                    }
+                    BoolChunkLoader life;
+                    grid.copy_to(life, {-24, -20});
+                    check(ok && grid.population() == (int64_t)expected_cells.size() && cells_of(life) == expected_cells,
+                        "dense " + name_of(c) + " " + std::to_string(width) + "x" + std::to_string(height)
+                        + (edge == Edge::wrap ? " wrap " : " dead ") + kernel_isa_name((KernelIsa)isa));
+                }
+            }
+        }
+    }
+    force_kernel_isa(picked);
+}
+
+// run_sharded() with one and several worker processes, and blocks deeper than one cell of halo
+template<int Shift>
+void check_shards(const std::vector<Case> &cases)
+{
+    for(const Case &c : cases)
+    {
+        const int len = c.generations.size() - 1;
+        for(const int shards : {1, 3})
+        {
+            for(const int block : {1, 4})
+            {
+                BasicBoolChunkLoader<BasicBoolChunk<Shift>> life;
+                life.set_rule(c.rule);
+                set_cells(life, c.start);
+                // stripes one chunk wide, so the cells cross between shards all the time
+                const bool ok = run_sharded(&life, shards, len, block, 1, false) != nullptr;
+                check(ok && cells_of(life) == c.generations[len] && census_matches(life, c.generations[len]),
+                    "shards " + name_of(c) + " side " + std::to_string(1 << Shift) + " shards " + std::to_string(shards)
+                    + " block " + std::to_string(block));
+            }
+        }
+    }
+}
+
+void check_hashlife(const std::vector<Case> &cases)
+{
+    for(const Case &c : cases)
+    {
+        const int len = c.generations.size() - 1;
+        // odd counts take every power of two step below them
+        for(const int generations : {1, len / 2 | 1, len})
+        {
+            BoolChunkLoader life;
+            set_cells(life, c.start);
+            HashLifeEngine engine(1 << 24, c.rule);
+            engine.import_from(life);
+            bool ok = engine.step(generations) && engine.generation() == (uint64_t)generations
+                && engine.population() == c.generations[generations].size();
+            engine.export_to(life);
+            ok = ok && census_matches(life, c.generations[generations]);
+            check(ok && cells_of(life) == c.generations[generations], "hashlife " + name_of(c) + " generations "
+                + std::to_string(generations));
+        }
+    }
+    // past what the coordinates can hold, nothing moves
+    BoolChunkLoader life;
+    set_cells(life, cases[0].start);
+    HashLifeEngine engine;
+    engine.import_from(life);
+    check(!engine.step((uint64_t)1 << 62) && engine.generation() == 0 && engine.population() == cases[0].start.size(),
+        "hashlife refuses a jump too far");
+}
+
+int main(int argc, char **argv)
+{
+    const bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    const int generations = quick ? 40 : 100;
+    std::vector<Case> cases;
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    // Life twice, HighLife and Day & Night have kernels of their own, B34/S34 goes through the generic one
+    const std::pair<const char *, int> soups[] = {{"B3/S23", 25}, {"B3/S23", 40}, {"B36/S23", 35}, {"B3678/S34678", 50},
+        {"B34/S34", 30}};
+    for(const auto &rule_percent : soups)
+    {
+        Case c;
+        c.seed = seed;
+        LifeRule::parse(rule_percent.first, c.rule);
+        // across the origin, so chunks on both sides of it and negative coordinates get tested
+        c.start = soup({-24, -20}, 48, rule_percent.second, seed);
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        c.generations.push_back(c.start);
+        for(int g = 0; g < generations; g++)
+            c.generations.push_back(step_reference(c.generations.back(), c.rule));
+        cases.push_back(c);
+    }
+    // a gun, so the chunks keep spreading
+    Case gun;
+    gun.seed = 0;
+    BoolChunkLoader gun_cells;
+    set_gosper_gun(gun_cells, {-40, -3});
+    gun.start = cells_of(gun_cells);
+    gun.generations.push_back(gun.start);
+    for(int g = 0; g < generations; g++)
+        gun.generations.push_back(step_reference(gun.generations.back(), gun.rule));
+    cases.push_back(gun);
+
+    WorkStealingPool pool(3);
+    check_chunks<5>(cases, pool);
+    if(!quick)
+    {
+        check_chunks<6>(cases, pool);
+        check_chunks<7>(cases, pool);
+    }
+    check_chunks<8>(cases, pool);
+    check_dense(cases, pool, quick ? 20 : 40);
+    check_shards<5>(cases);
+    if(!quick)
+        check_shards<6>(cases);
+    check_hashlife(cases);
+    return test_result();
+}
@@ -0,0 +1,452 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "chunks.cpp"
+
+class HashLifeEngine : public BoolGrid2D
+{
+    /**
+     * @brief Universe as a hash-consed quadtree with memoized results (Gosper's HashLife)
+     * Identical squares are stored once, and the future of each square is cached, so repetitive patterns
+     * can jump 2^k generations in about as much work as one.
+     * The root is always centered on (0, 0).
+     */
+    struct Node
+    {
+        uint32_t nw, ne, sw, se; // children, level - 1
+        uint32_t result; // centre, 2^(level - 2) generations later
+        uint32_t slow_result; // centre, 2^slow_step generations later
+        int8_t slow_step;
+        uint8_t level;
+        uint64_t population;
+    };
+
+    static constexpr uint32_t none = UINT32_MAX;
+    static const int max_level = 62; // keeps coordinates in int64_t
+    static const int chunk_level = BoolChunk::side_shift;
+
+    std::vector<Node> nodes; // 0 and 1 are the dead and live cell
+    std::vector<uint32_t> table; // node ids by children, none if empty
+    size_t table_count = 0;
+    std::vector<uint32_t> empty_nodes; // by level
+    uint32_t root;
+    uint64_t generations = 0;
+    size_t gc_limit;
+    LifeRule life_rule; // fixed, the cached results depend on it
+
+    static inline size_t hash_children(const uint32_t nw, const uint32_t ne, const uint32_t sw, const uint32_t se)
+    {
+        uint64_t h = nw * 0x9E3779B97F4A7C15ull;
+        h = (h ^ ne) * 0xC2B2AE3D27D4EB4Full;
+        h = (h ^ sw) * 0x165667B19E3779F9ull;
+        h = (h ^ se) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29);
+    }
+
+    void table_insert(const uint32_t id)
+    {
+        const Node &node = nodes[id];
+        const size_t mask = table.size() - 1;
+        size_t i = hash_children(node.nw, node.ne, node.sw, node.se) & mask;
+        while(table[i] != none)
+            i = (i + 1) & mask;
+        table[i] = id;
+        table_count++;
+    }
+
+    void rebuild_table(size_t capacity)
+    {
+        table.assign(capacity, none);
+        table_count = 0;
+        for(uint32_t id = 2; id < nodes.size(); id++)
+            table_insert(id);
+    }
+
+    // The one node with these children
+    uint32_t join(const uint32_t nw, const uint32_t ne, const uint32_t sw, const uint32_t se)
+    {
+        const size_t mask = table.size() - 1;
+        size_t i = hash_children(nw, ne, sw, se) & mask;
+        for(; table[i] != none; i = (i + 1) & mask)
+        {
+            const Node &node = nodes[table[i]];
+            if(node.nw == nw && node.ne == ne && node.sw == sw && node.se == se)
+                return table[i];
+        }
+        Node node;
+        node.nw = nw;
+        node.ne = ne;
+        node.sw = sw;
+        node.se = se;
+        node.result = none;
+        node.slow_result = none;
+        node.slow_step = -1;
+        node.level = nodes[nw].level + 1;
+        node.population = nodes[nw].population + nodes[ne].population + nodes[sw].population + nodes[se].population;
+        const uint32_t id = nodes.size();
+        nodes.push_back(node);
+        if((table_count + 1) * 2 > table.size())
+            rebuild_table(table.size() * 2);
+        else
+        {
+            table[i] = id;
+            table_count++;
+        }
+        return id;
+    }
+
+    uint32_t empty(const int level)
+    {
+        if(empty_nodes.empty())
+            empty_nodes.push_back(0);
+        while((int)empty_nodes.size() <= level)
+        {
+            const uint32_t child = empty_nodes.back();
+            empty_nodes.push_back(join(child, child, child, child));
+        }
+        return empty_nodes[level];
+    }
+
+    // Level - 1 node made of the 4 inner grandchildren
+    uint32_t centre(const uint32_t id)
+    {
+        const Node node = nodes[id];
+        return join(nodes[node.nw].se, nodes[node.ne].sw, nodes[node.sw].ne, nodes[node.se].nw);
+    }
+
+    // Level + 1 node with id in the middle
+    uint32_t expand(const uint32_t id)
+    {
+        const Node node = nodes[id];
+        const uint32_t e = empty(node.level - 1);
+        return join(join(e, e, e, node.nw), join(e, e, node.ne, e), join(e, node.sw, e, e), join(node.se, e, e, e));
+    }
+
+    // All live cells are in the centre half, so the node can grow without losing anything
+    bool padded(const uint32_t id) const
+    {
+        const Node &node = nodes[id];
+        if(node.level < 2)
+            return node.population == 0;
+        return node.population == nodes[nodes[node.nw].se].population + nodes[nodes[node.ne].sw].population
+            + nodes[nodes[node.sw].ne].population + nodes[nodes[node.se].nw].population;
+    }
+
+    // 4x4 to its 2x2 centre one generation later
+    uint32_t base_step(const uint32_t id)
+    {
+        const Node &node = nodes[id];
+        const uint32_t quads[4] = {node.nw, node.ne, node.sw, node.se};
+        int cells[4][4];
+        for(int q = 0; q < 4; q++)
+        {
+            const Node &quad = nodes[quads[q]];
+            const int x = (q & 1) * 2, y = (q >> 1) * 2;
+            cells[y][x] = quad.nw;
+            cells[y][x + 1] = quad.ne;
+            cells[y + 1][x] = quad.sw;
+            cells[y + 1][x + 1] = quad.se;
+        }
+        uint32_t next[4];
+        for(int i = 0; i < 4; i++)
+        {
+            const int x = 1 + (i & 1), y = 1 + (i >> 1);
+            int sum = -cells[y][x];
+            for(int dy = -1; dy <= 1; dy++)
+                for(int dx = -1; dx <= 1; dx++)
+                    sum += cells[y + dy][x + dx];
+            next[i] = life_rule.next(cells[y][x], sum);
+        }
+        return join(next[0], next[1], next[2], next[3]);
+    }
+
+    // Centre of id, 2^step generations later. step is at most level - 2
+    uint32_t successor(const uint32_t id, const int step)
+    {
+        const Node node = nodes[id];
+        if(node.population == 0)
+            return empty(node.level - 1);
+        const bool full = step == node.level - 2;
+        if(full && node.result != none)
+            return node.result;
+        if(!full && node.slow_step == step && node.slow_result != none)
+            return node.slow_result;
+        uint32_t res;
+        if(node.level == 2)
+            res = base_step(id);
+        else
+        {
+            const Node a = nodes[node.nw], b = nodes[node.ne], c = nodes[node.sw], d = nodes[node.se];
+            // 9 overlapping subsquares, 3x3
+            const uint32_t sub[9] = {
+                node.nw, join(a.ne, b.nw, a.se, b.sw), node.ne,
+                join(a.sw, a.se, c.nw, c.ne), join(a.se, b.sw, c.ne, d.nw), join(b.sw, b.se, d.nw, d.ne),
+                node.sw, join(c.ne, d.nw, c.se, d.sw), node.se
+            };
+            const int first = std::min(step, node.level - 3);
+            uint32_t r[9];
+            for(int i = 0; i < 9; i++)
+                r[i] = successor(sub[i], first);
+            uint32_t quads[4];
+            for(int q = 0; q < 4; q++)
+            {
+                const int i = (q >> 1) * 3 + (q & 1);
+                const uint32_t quad = join(r[i], r[i + 1], r[i + 3], r[i + 4]);
+                // the second half of a full jump, otherwise just line the pieces up
+                quads[q] = full ? successor(quad, node.level - 3) : centre(quad);
+            }
+            res = join(quads[0], quads[1], quads[2], quads[3]);
+        }
+        Node &memo = nodes[id];
+        if(full)
+            memo.result = res;
+        else
+        {
+            memo.slow_step = step;
+            memo.slow_result = res;
+        }
+        return res;
+    }
+
+    // Copies id and what it reaches into kept, old ids map to new ones in remap
+    uint32_t keep(const uint32_t id, std::vector<Node> &kept, std::vector<uint32_t> &remap) const
+    {
+        if(remap[id] != none)
+            return remap[id];
+        Node node = nodes[id];
+        node.nw = keep(node.nw, kept, remap);
+        node.ne = keep(node.ne, kept, remap);
+        node.sw = keep(node.sw, kept, remap);
+        node.se = keep(node.se, kept, remap);
+        remap[id] = kept.size();
+        kept.push_back(node);
+        return remap[id];
+    }
+
+    // Drops every node the root does not use, along with cached results pointing at them
+    void collect_garbage()
+    {
+        std::vector<Node> kept;
+        std::vector<uint32_t> remap(nodes.size(), none);
+        kept.push_back(nodes[0]);
+        kept.push_back(nodes[1]);
+        remap[0] = 0;
+        remap[1] = 1;
+        root = keep(root, kept, remap);
+        for(auto iter = kept.begin() + 2; iter != kept.end(); ++iter)
+        {
+            iter->result = iter->result != none ? remap[iter->result] : none;
+            iter->slow_result = iter->slow_result != none ? remap[iter->slow_result] : none;
+        }
+        nodes.swap(kept);
+        empty_nodes.clear();
+        size_t capacity = 1 << 10;
+        while(capacity < nodes.size() * 4)
+            capacity <<= 1;
+        rebuild_table(capacity);
+    }
+
+    inline int64_t half(const uint32_t id) const
+    {
+        return (int64_t)1 << (nodes[id].level - 1);
+    }
+
+    // Replaces the level sub_level square at (x, y) inside id, relative to its top left corner
+    uint32_t replace(const uint32_t id, const int64_t x, const int64_t y, const uint32_t sub)
+    {
+        const Node node = nodes[id];
+        if(node.level == nodes[sub].level)
+            return sub;
+        const int64_t h = half(id);
+        if(y < h)
+        {
+            if(x < h)
+                return join(replace(node.nw, x, y, sub), node.ne, node.sw, node.se);
+            return join(node.nw, replace(node.ne, x - h, y, sub), node.sw, node.se);
+        }
+        if(x < h)
+            return join(node.nw, node.ne, replace(node.sw, x, y - h, sub), node.se);
+        return join(node.nw, node.ne, node.sw, replace(node.se, x - h, y - h, sub));
+    }
+
+    // Grows the root until (x, y) is inside it
+    bool reach(const int64_t x, const int64_t y)
+    {
+        while(x < -half(root) || x >= half(root) || y < -half(root) || y >= half(root))
+        {
+            if(nodes[root].level >= max_level)
+                return false;
+            root = expand(root);
+        }
+        return true;
+    }
+
+    // Square of packed rows to a node, rows are side_len_b wide
+    uint32_t from_rows(const uint32_t *rows, const int x, const int y, const int level)
+    {
+        if(level == 0)
+            return (rows[y] >> x) & 1;
+        const int h = 1 << (level - 1);
+        return join(from_rows(rows, x, y, level - 1), from_rows(rows, x + h, y, level - 1),
+            from_rows(rows, x, y + h, level - 1), from_rows(rows, x + h, y + h, level - 1));
+    }
+
+    void to_rows(const uint32_t id, const int x, const int y, uint32_t *rows) const
+    {
+        const Node &node = nodes[id];
+        if(node.population == 0)
+            return;
+        if(node.level == 0)
+        {
+            rows[y] |= (uint32_t)1 << x;
+            return;
+        }
+        const int h = 1 << (node.level - 1);
+        to_rows(node.nw, x, y, rows);
+        to_rows(node.ne, x + h, y, rows);
+        to_rows(node.sw, x, y + h, rows);
+        to_rows(node.se, x + h, y + h, rows);
+    }
+
+    void export_node(const uint32_t id, const int64_t x, const int64_t y, BoolChunkLoader &life) const
+    {
+        const Node &node = nodes[id];
+        if(node.population == 0)
+            return;
+        if(node.level == chunk_level)
+        {
+            if(x < INT32_MIN || x > INT32_MAX - BoolChunk::side_len_b || y < INT32_MIN || y > INT32_MAX - BoolChunk::side_len_b)
+                return; // out of Vect2i range
+            uint32_t rows[BoolChunk::side_len_b] = {};
+            to_rows(id, 0, 0, rows);
+            life.load_chunk({(int)x, (int)y})->set_rows(rows, node.population);
+            return;
+        }
+        const int64_t h = half(id);
+        export_node(node.nw, x, y, life);
+        export_node(node.ne, x + h, y, life);
+        export_node(node.sw, x, y + h, life);
+        export_node(node.se, x + h, y + h, life);
+    }
+
+public:
+    // gc_limit is the node count that triggers a garbage collection before a step
+    HashLifeEngine(size_t gc_limit = 1 << 24, const LifeRule &rule = LifeRule()) : gc_limit(gc_limit), life_rule(rule)
+    {
+        Node leaf = {0, 0, 0, 0, none, none, -1, 0, 0};
+        nodes.push_back(leaf);
+        leaf.population = 1;
+        nodes.push_back(leaf);
+        table.assign(1 << 10, none);
+        root = empty(chunk_level + 1); // so level chunk_level squares line up with the chunks
+    }
+
+    // Very slow, use import/export for whole patterns
+    bool get(const Vect2i &pos) const override
+    {
+        int64_t x = pos.x + half(root), y = pos.y + half(root);
+        if(x < 0 || y < 0 || x >= 2 * half(root) || y >= 2 * half(root))
+            return 0;
+        uint32_t id = root;
+        while(nodes[id].level > 0 && nodes[id].population != 0)
+        {
+            const Node &node = nodes[id];
+            const int64_t h = half(id);
+            if(y < h)
+                id = x < h ? node.nw : node.ne;
+            else
+                id = x < h ? node.sw : node.se;
+            x %= h;
+            y %= h;
+        }
+        return nodes[id].population != 0;
+    }
+
+    // Very slow, use import/export for whole patterns
+    void set(const Vect2i &pos, bool val) override
+    {
+        if(!reach(pos.x, pos.y))
+            return;
+        root = replace(root, pos.x + half(root), pos.y + half(root), val ? 1 : 0);
+    }
+
+    // Adds the live cells of the current generation of life
+    void import_from(BoolChunkLoader &life)
+    {
+        uint32_t rows[BoolChunk::side_len_b];
+        for(const auto entry : life.loaded_chunks())
+        {
+            if(entry.chunk.live_cells == 0)
+                continue;
+            const Vect2i &chunk_pos = entry.pos;
+            for(int y = 0; y < BoolChunk::side_len_b; y++)
+                rows[y] = entry.chunk.get_row(y);
+            if(!reach(chunk_pos.x, chunk_pos.y) || !reach(chunk_pos.x + BoolChunk::side_len_b - 1, chunk_pos.y + BoolChunk::side_len_b - 1))
+                continue;
+            const uint32_t sub = from_rows(rows, 0, 0, chunk_level);
+            root = replace(root, chunk_pos.x + half(root), chunk_pos.y + half(root), sub);
+        }
+    }
+
+    // Replaces the contents and rule of life with ours
+    void export_to(BoolChunkLoader &life)
+    {
+        life.clear();
+        life.set_rule(life_rule);
+        export_node(root, -half(root), -half(root), life);
+    }
+
+    // Advances 2^step generations. False, and nothing advanced, if the pattern would grow past max_level
+    bool step_pow2(const int step)
+    {
+        if(step < 0 || step > max_level - 3)
+            return false;
+        if(nodes.size() > gc_limit)
+            collect_garbage();
+        while(nodes[root].level < step + 2 || !padded(root))
+        {
+            if(nodes[root].level >= max_level)
+                return false;
+            root = expand(root);
+        }
+        if(nodes[root].level >= max_level)
+            return false;
+        root = successor(expand(root), step);
+        generations += (uint64_t)1 << step;
+        return true;
+    }
+
+    // False if it stopped short, generation() says how far it got
+    bool step(uint64_t count)
+    {
+        for(int i = 63; i >= 0; i--)
+        {
+            if((count >> i & 1) && !step_pow2(i))
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t generation() const
+    {
+        return generations;
+    }
+
+    const LifeRule& rule() const
+    {
+        return life_rule;
+    }
+
+    uint64_t population() const
+    {
+        return nodes[root].population;
+    }
+
+    size_t node_count() const
+    {
+        return nodes.size();
+    }
+};
@@ -0,0 +1,245 @@
+#pragma once
+#include <stdint.h>
+#include <string.h> // for memcpy
+#include <utility>
+
+#include "rule.hpp"
+
+// Bit-parallel life kernel, works on packed rows of 32 or 64 cells.
+// Bit x of a row is cell x, same layout as BasicBoolChunk::bytes.
+
+template<typename Word, int Side>
+struct BasicChunkHalo
+{
+    /**
+     * @brief Packed rows of a chunk and its 8 neighbours, as seen by the kernel
+     * Index 0 is the last row of the chunks above, index side + 1 the first row of the chunks bellow.
+     * Missing chunks are just 0 rows. Rows past side + 1 are padding for the widest vector loads.
+     * Chunks wider than a word are done one word column at a time, west and east are then the words next to it.
+     */
+    typedef Word word_t;
+    static const int word_bits = sizeof(Word) * 8;
+    static const int side = Side;
+    static const int rows = side + 2;
+    static const int padded_rows = (rows + 15) / 16 * 16;
+    Word west[padded_rows];
+    Word centre[padded_rows];
+    Word east[padded_rows];
+};
+
+typedef BasicChunkHalo<uint32_t, 32> ChunkHalo;
+typedef BasicChunkHalo<uint64_t, 64> ChunkHalo64;
+typedef BasicChunkHalo<uint64_t, 128> ChunkHalo128;
+typedef BasicChunkHalo<uint64_t, 256> ChunkHalo256;
+
+// Every geometry the kernels are built for, X(halo type) is expanded once for each
+#define LIFE_KERNEL_HALOS(X) X(ChunkHalo) X(ChunkHalo64) X(ChunkHalo128) X(ChunkHalo256)
+
+// Kernel Rule argument for the generic kernel, that reads the rule at run time
+static const uint32_t any_rule = ~(uint32_t)0;
+
+// Rules with a kernel of their own, X(arg, LifeRule::code()) is expanded once for each and once for any_rule
+#define LIFE_KERNEL_RULES(X, arg) \
+    X(arg, LifeRule::code_of("B3/S23")) /* Life */ \
+    X(arg, LifeRule::code_of("B36/S23")) /* HighLife */ \
+    X(arg, LifeRule::code_of("B3678/S34678")) /* Day & Night */ \
+    X(arg, LifeRule::code_of("B2/S")) /* Seeds */ \
+    X(arg, LifeRule::code_of("B1357/S1357")) /* Replicator */ \
+    X(arg, LifeRule::code_of("B368/S245")) /* Morley */ \
+    X(arg, any_rule)
+
+// Cells whose 3x3 sum, themselves included, is T, from the bits of the sum
+template<int T, typename Rows>
+inline Rows sum_is(const Rows &ones, const Rows &twos, const Rows &fours, const Rows &eights)
+{
+    return (T & 1 ? ones : ~ones) & (T & 2 ? twos : ~twos) & (T & 4 ? fours : ~fours) & (T & 8 ? eights : ~eights);
+}
+
+// Cells alive next generation out of those with a 3x3 sum of T.
+// A live cell with sum T has T - 1 neighbours, a dead one T.
+// With a baked rule the terms that can not be alive drop out at compile time, Life ends up with 2 of the 10.
+// Otherwise birth and survive hold a full or empty mask for every sum.
+template<uint32_t Rule, int T, typename Rows>
+inline Rows rule_term(const Rows &alive, const Rows &ones, const Rows &twos, const Rows &fours, const Rows &eights,
+    const Rows *birth, const Rows *survive)
+{
+    if constexpr (Rule == any_rule)
+        return sum_is<T>(ones, twos, fours, eights) & ((alive & survive[T]) | (~alive & birth[T]));
+    else
+    {
+        constexpr bool born = LifeRule::from_code(Rule).birth >> T & 1;
+        constexpr bool survives = LifeRule::from_code(Rule).survive << 1 >> T & 1;
+        if constexpr (born && survives)
+            return sum_is<T>(ones, twos, fours, eights);
+        else if constexpr (born)
+            return ~alive & sum_is<T>(ones, twos, fours, eights);
+        else if constexpr (survives)
+            return alive & sum_is<T>(ones, twos, fours, eights);
+        else
+            return Rows{};
+    }
+}
+
+template<uint32_t Rule, typename Rows, int... T>
+inline Rows apply_rule(const Rows &alive, const Rows &ones, const Rows &twos, const Rows &fours, const Rows &eights,
+    const Rows *birth, const Rows *survive, std::integer_sequence<int, T...>)
+{
+    return (rule_term<Rule, T>(alive, ones, twos, fours, eights, birth, survive) | ...);
+}
+
+// Full or empty masks by 3x3 sum, only filled in and read by the generic kernel
+template<typename Word, typename Rows, uint32_t Rule>
+inline void rule_masks(const LifeRule &rule, Rows *birth, Rows *survive)
+{
+    if(Rule == any_rule)
+    {
+        for(int t = 0; t < 10; t++)
+        {
+            birth[t] = Rows{} - (Word)(rule.birth >> t & 1);
+            survive[t] = Rows{} - (Word)(rule.survive << 1 >> t & 1);
+        }
+    }
+}
+
+// 3 cell horizontal sums of rows 0 to count (rounded up to whole Rows), 2 bits each (s0 + 2*s1).
+// west and east are the words left and right of centre.
+template<typename Word, typename Rows>
+inline void sum_rows(const Word *west, const Word *centre, const Word *east, Word *s0, Word *s1, const int count)
+{
+    static const int lanes = sizeof(Rows) / sizeof(Word);
+    static const int top = sizeof(Word) * 8 - 1;
+    for(int y = 0; y < count; y += lanes)
+    {
+        Rows c, w, e;
+        memcpy(&c, &centre[y], sizeof(c));
+        memcpy(&w, &west[y], sizeof(w));
+        memcpy(&e, &east[y], sizeof(e));
+        const Rows l = (c << 1) | (w >> top); // cell x-1
+        const Rows r = (c >> 1) | (e << top); // cell x+1
+        const Rows sum0 = l ^ c ^ r;
+        const Rows sum1 = (l & c) | (r & (l ^ c));
+        memcpy(&s0[y], &sum0, sizeof(sum0));
+        memcpy(&s1[y], &sum1, sizeof(sum1));
+    }
+}
+
+// Next generation of count rows, from the horizontal sums of the row above each (s0[y], s1[y]) and the 2 after it.
+// alive[y] is the row itself.
+template<typename Word, typename Rows, uint32_t Rule>
+inline void step_rows(const Word *s0, const Word *s1, const Word *alive, Word *result, const int count,
+    const Rows *birth, const Rows *survive)
+{
+    static const int lanes = sizeof(Rows) / sizeof(Word);
+    auto load = [](const Word *src) -> Rows
+    {
+        Rows val;
+        memcpy(&val, src, sizeof(val));
+        return val;
+    };
+    for(int y = 0; y < count; y += lanes)
+    {
+        // add the 3 horizontal sums, giving the 3x3 sum (cell included) in 4 bits
+        const Rows a0 = load(&s0[y]), b0 = load(&s0[y + 1]), c0 = load(&s0[y + 2]);
+        const Rows a1 = load(&s1[y]), b1 = load(&s1[y + 1]), c1 = load(&s1[y + 2]);
+        const Rows ones = a0 ^ b0 ^ c0;
+        const Rows carry = (a0 & b0) | (c0 & (a0 ^ b0));
+        const Rows t = a1 ^ b1 ^ c1;
+        const Rows tc = (a1 & b1) | (c1 & (a1 ^ b1));
+        const Rows twos = t ^ carry;
+        const Rows fours = tc ^ (t & carry);
+        const Rows eights = tc & t & carry;
+        const Rows next = apply_rule<Rule>(load(&alive[y]), ones, twos, fours, eights, birth, survive,
+            std::make_integer_sequence<int, 10>());
+        memcpy(&result[y], &next, sizeof(next));
+    }
+}
+
+// Next generation of the centre chunk, returns the live cell count of the result.
+// Neighbour counts are done with full adders over whole rows, so 32 or 64 cells per op.
+// Rows is either the halo word or a gcc vector of them, in which case each op covers several rows.
+// Rule is a LifeRule::code() baked in, or any_rule to go by rule.
+template<typename Halo, typename Rows, uint32_t Rule>
+inline int life_step_rows_v(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule)
+{
+    typedef typename Halo::word_t Word;
+    static const int lanes = sizeof(Rows) / sizeof(Word);
+    static_assert(Halo::side % lanes == 0, "Rows must evenly split a chunk");
+    static_assert((Halo::rows + lanes - 1) / lanes * lanes <= Halo::padded_rows, "Not enough padding for Rows");
+    Rows birth[10], survive[10];
+    rule_masks<Word, Rows, Rule>(rule, birth, survive);
+    alignas(64) Word s0[Halo::padded_rows], s1[Halo::padded_rows];
+    sum_rows<Word, Rows>(halo.west, halo.centre, halo.east, s0, s1, Halo::rows);
+    step_rows<Word, Rows, Rule>(s0, s1, halo.centre + 1, result, Halo::side, birth, survive);
+    int live_cells = 0;
+    for(int y = 0; y < Halo::side; y++)
+        live_cells += __builtin_popcountll(result[y]);
+    return live_cells;
+}
+
+template<typename Halo, uint32_t Rule>
+inline int life_step_rows(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule)
+{
+    return life_step_rows_v<Halo, typename Halo::word_t, Rule>(halo, result, rule);
+}
+
+// Columns for stepping a chunk several generations in a row (temporal blocking): a 64 cell wide strip of
+// a chunk and the cells around it, any number of rows up to column_rows. The valid part shrinks every generation,
+// so only rows first to last are computed, from rows first - 1 to last. Words past the end of the column
+// up to column_padded_rows are read and written as padding for the vector loads.
+static const int column_rows = 256 + 2 * 32; // biggest chunk and the most generations it is stepped by
+static const int column_padded_rows = (column_rows + 16 + 15) / 16 * 16;
+
+template<typename Rows, uint32_t Rule>
+inline void life_step_column_v(const uint64_t *west, const uint64_t *centre, const uint64_t *east, uint64_t *result,
+    const int first, const int last, const LifeRule &rule)
+{
+    Rows birth[10], survive[10];
+    rule_masks<uint64_t, Rows, Rule>(rule, birth, survive);
+    alignas(64) uint64_t s0[column_padded_rows], s1[column_padded_rows];
+    sum_rows<uint64_t, Rows>(west + first - 1, centre + first - 1, east + first - 1, s0, s1, last - first + 2);
+    step_rows<uint64_t, Rows, Rule>(s0, s1, centre + first, result + first, last - first, birth, survive);
+}
+
+// Runtime dispatch, every variant is in the binary and the best one the cpu supports is used.
+// Set LIFE_KERNEL=scalar|sse2|avx2|avx512 or call force_kernel_isa() to pick one by hand.
+enum class KernelIsa
+{
+    scalar,
+    sse2,
+    avx2,
+    avx512,
+    count
+};
+
+template<typename Halo>
+using BasicLifeStepFn = int (*)(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule);
+typedef BasicLifeStepFn<ChunkHalo> LifeStepFn;
+typedef void (*LifeColumnFn)(const uint64_t *west, const uint64_t *centre, const uint64_t *east, uint64_t *result,
+    int first, int last, const LifeRule &rule);
+
+const char* kernel_isa_name(KernelIsa isa);
+bool kernel_isa_supported(KernelIsa isa);
+bool force_kernel_isa(KernelIsa isa); // false if the cpu can not run it
+KernelIsa kernel_isa();
+// Only built for the halos in LIFE_KERNEL_HALOS. Pass the same rule to the kernel, the baked ones ignore it
+template<typename Halo = ChunkHalo>
+BasicLifeStepFn<Halo> life_step_kernel(const LifeRule &rule = LifeRule());
+LifeColumnFn life_column_kernel(const LifeRule &rule = LifeRule()); // see life_step_column_v
+bool kernel_rule_baked(const LifeRule &rule); // false if rule goes through the generic kernel
+
+// Variants, each in its own translation unit built for that isa
+template<typename Halo, uint32_t Rule>
+int life_step_rows_sse2(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule);
+template<typename Halo, uint32_t Rule>
+int life_step_rows_avx2(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule);
+template<typename Halo, uint32_t Rule>
+int life_step_rows_avx512(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule);
+template<uint32_t Rule>
+void life_step_column_sse2(const uint64_t *west, const uint64_t *centre, const uint64_t *east, uint64_t *result,
+    int first, int last, const LifeRule &rule);
+template<uint32_t Rule>
+void life_step_column_avx2(const uint64_t *west, const uint64_t *centre, const uint64_t *east, uint64_t *result,
+    int first, int last, const LifeRule &rule);
+template<uint32_t Rule>
+void life_step_column_avx512(const uint64_t *west, const uint64_t *centre, const uint64_t *east, uint64_t *result,
+    int first, int last, const LifeRule &rule);
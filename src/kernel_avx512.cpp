@@ -0,0 +1,29 @@
+// Built with -mavx512f, see CMakeLists.txt. Only called when the cpu supports it.
+#include <type_traits>
+#include <kernel.hpp>
+
+typedef uint32_t avx512_rows32 __attribute__((vector_size(64)));
+typedef uint64_t avx512_rows64 __attribute__((vector_size(64)));
+
+template<typename Halo, uint32_t Rule>
+int life_step_rows_avx512(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule)
+{
+    typedef typename std::conditional<Halo::word_bits == 32, avx512_rows32, avx512_rows64>::type Rows;
+    return life_step_rows_v<Halo, Rows, Rule>(halo, result, rule);
+}
+
+template<uint32_t Rule>
+void life_step_column_avx512(const uint64_t *west, const uint64_t *centre, const uint64_t *east, uint64_t *result,
+    const int first, const int last, const LifeRule &rule)
+{
+    life_step_column_v<avx512_rows64, Rule>(west, centre, east, result, first, last, rule);
+}
+
+#define INSTANTIATE_RULE(Halo, Rule) \
+    template int life_step_rows_avx512<Halo, Rule>(const Halo &halo, Halo::word_t *result, const LifeRule &rule);
+#define INSTANTIATE(Halo) LIFE_KERNEL_RULES(INSTANTIATE_RULE, Halo)
+LIFE_KERNEL_HALOS(INSTANTIATE)
+#define INSTANTIATE_COLUMN(unused, Rule) \
+    template void life_step_column_avx512<Rule>(const uint64_t *west, const uint64_t *centre, const uint64_t *east, \
+        uint64_t *result, int first, int last, const LifeRule &rule);
+LIFE_KERNEL_RULES(INSTANTIATE_COLUMN, )
@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+#include "kernel.hpp"
+#include "tests.hpp"
+
+// The row kernels, every one the cpu can run, for every chunk geometry and for rules with a kernel of their own and
+// without, against counting the neighbours of every cell, on random chunks and halos
+
+// Bit x of row y of the word column the halo is around, x from -1 to the word width, y from -1 to side
+template<typename Halo>
+bool halo_cell(const Halo &halo, const int x, const int y)
+{
+    if(x < 0)
+        return halo.west[y + 1] >> (Halo::word_bits - 1) & 1;
+    if(x >= Halo::word_bits)
+        return halo.east[y + 1] & 1;
+    return halo.centre[y + 1] >> x & 1;
+}
+
+template<typename Halo>
+bool step_matches(const Halo &halo, const typename Halo::word_t *result, const int live_cells, const LifeRule &rule)
+{
+    int expected_live = 0;
+    for(int y = 0; y < Halo::side; y++)
+    {
+        for(int x = 0; x < Halo::word_bits; x++)
+        {
+            int sum = 0;
+            for(int dy = -1; dy <= 1; dy++)
+            {
+                for(int dx = -1; dx <= 1; dx++)
+                {
+                    if(dx != 0 || dy != 0)
+                        sum += halo_cell(halo, x + dx, y + dy);
+                }
+            }
+            const int next = rule.next(halo_cell(halo, x, y), sum);
+            if(next != (int)(result[y] >> x & 1))
+                return false;
+            expected_live += next;
+        }
+    }
+    return live_cells == expected_live;
+}
+
+// Random rows, each bit set with a chance of density / 8
+template<typename Word>
+void fill(Word *rows, const int count, const int density, uint64_t &state)
+{
+    for(int y = 0; y < count; y++)
+    {
+        Word row = 0;
+        for(int bit = 0; bit < 3; bit++)
+        {
+            const Word random = next_random(state);
+            row = density >> bit & 1 ? row | random : row & random;
+        }
+        rows[y] = row;
+    }
+}
+
+// Every kernel the cpu can run on one geometry, the same halos for every kernel
+template<typename Halo>
+void check_halo(const LifeRule &rule)
+{
+    for(int isa = 0; isa < (int)KernelIsa::count; isa++)
+    {
+        if(!force_kernel_isa((KernelIsa)isa))
+            continue;
+        const BasicLifeStepFn<Halo> life_step = life_step_kernel<Halo>(rule);
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for(const int density : {1, 3, 4, 5, 7})
+        {
+            bool ok = true;
+            for(int round = 0; ok && round < 50; round++)
+            {
+                Halo halo;
+                fill(halo.west, Halo::rows, density, state);
+                fill(halo.centre, Halo::rows, density, state);
+                fill(halo.east, Halo::rows, density, state);
+                typename Halo::word_t result[Halo::side];
+                const int live_cells = life_step(halo, result, rule);
+                ok = step_matches(halo, result, live_cells, rule);
+            }
+            check(ok, rule.to_string() + " " + kernel_isa_name((KernelIsa)isa) + " side " + std::to_string(Halo::side) + " density "
+                + std::to_string(density) + "/8");
+        }
+    }
+}
+
+int main()
+{
+    // baked in, then through the generic kernel
+    const std::pair<const char *, bool> rules[] = {{"B3/S23", true}, {"B36/S23", true}, {"B3678/S34678", true},
+        {"B2/S", true}, {"B34/S34", false}, {"B3/S012345678", false}, {"B12345678/S", false}};
+    for(const auto &entry : rules)
+    {
+        LifeRule rule;
+        LifeRule::parse(entry.first, rule);
+        check(kernel_rule_baked(rule) == entry.second, rule.to_string() + (entry.second ? " baked" : " generic"));
+        check_halo<ChunkHalo>(rule);
+        check_halo<ChunkHalo64>(rule);
+        check_halo<ChunkHalo128>(rule);
+        check_halo<ChunkHalo256>(rule);
+    }
+    return test_result();
+}
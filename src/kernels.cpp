@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <iostream>
+
+#include <kernel.hpp>
+
+template<typename Halo, uint32_t Rule>
+static int life_step_rows_scalar(const Halo &halo, typename Halo::word_t *result, const LifeRule &rule)
+{
+    return life_step_rows<Halo, Rule>(halo, result, rule);
+}
+
+template<uint32_t Rule>
+static void life_step_column_scalar(const uint64_t *west, const uint64_t *centre, const uint64_t *east, uint64_t *result,
+    const int first, const int last, const LifeRule &rule)
+{
+    life_step_column_v<uint64_t, Rule>(west, centre, east, result, first, last, rule);
+}
+
+static const char* const isa_names[] = {"scalar", "sse2", "avx2", "avx512"};
+static_assert(sizeof(isa_names) / sizeof(*isa_names) == (int)KernelIsa::count, "Missing isa name");
+
+const char* kernel_isa_name(KernelIsa isa)
+{
+    return isa_names[(int)isa];
+}
+
+bool kernel_isa_supported(KernelIsa isa)
+{
+    // cpuid via the compiler builtins, they also check the os saves the wide registers
+    switch (isa)
+    {
+    case KernelIsa::scalar:
+        return true;
+#ifdef LIFE_KERNEL_X86
+    case KernelIsa::sse2:
+        return __builtin_cpu_supports("sse2");
+    case KernelIsa::avx2:
+        return __builtin_cpu_supports("avx2");
+    case KernelIsa::avx512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+static KernelIsa best_isa()
+{
+    const char *forced = getenv("LIFE_KERNEL");
+    if(forced)
+    {
+        for(int i = 0; i < (int)KernelIsa::count; i++)
+        {
+            if(strcmp(forced, isa_names[i]) == 0 && kernel_isa_supported((KernelIsa)i))
+                return (KernelIsa)i;
+        }
+        std::cerr << "LIFE_KERNEL=" << forced << " is unknown or not supported, picking automatically\n";
+    }
+    for(int i = (int)KernelIsa::count - 1; i > 0; i--)
+    {
+        if(kernel_isa_supported((KernelIsa)i))
+            return (KernelIsa)i;
+    }
+    return KernelIsa::scalar;
+}
+
+static KernelIsa current_isa = best_isa();
+
+bool force_kernel_isa(KernelIsa isa)
+{
+    if(!kernel_isa_supported(isa))
+        return false;
+    current_isa = isa;
+    return true;
+}
+
+KernelIsa kernel_isa()
+{
+    return current_isa;
+}
+
+template<typename Halo, uint32_t Rule>
+static BasicLifeStepFn<Halo> isa_kernel()
+{
+    switch (current_isa)
+    {
+#ifdef LIFE_KERNEL_X86
+    case KernelIsa::sse2:
+        return life_step_rows_sse2<Halo, Rule>;
+    case KernelIsa::avx2:
+        return life_step_rows_avx2<Halo, Rule>;
+    case KernelIsa::avx512:
+        return life_step_rows_avx512<Halo, Rule>;
+#endif
+    default:
+        return life_step_rows_scalar<Halo, Rule>;
+    }
+}
+
+template<typename Halo>
+BasicLifeStepFn<Halo> life_step_kernel(const LifeRule &rule)
+{
+#define PICK_RULE(unused, Rule) \
+    if(rule.code() == Rule) \
+        return isa_kernel<Halo, Rule>();
+    LIFE_KERNEL_RULES(PICK_RULE, )
+#undef PICK_RULE
+    return isa_kernel<Halo, any_rule>();
+}
+
+template<uint32_t Rule>
+static LifeColumnFn isa_column_kernel()
+{
+    switch (current_isa)
+    {
+#ifdef LIFE_KERNEL_X86
+    case KernelIsa::sse2:
+        return life_step_column_sse2<Rule>;
+    case KernelIsa::avx2:
+        return life_step_column_avx2<Rule>;
+    case KernelIsa::avx512:
+        return life_step_column_avx512<Rule>;
+#endif
+    default:
+        return life_step_column_scalar<Rule>;
+    }
+}
+
+LifeColumnFn life_column_kernel(const LifeRule &rule)
+{
+#define PICK_RULE(unused, Rule) \
+    if(rule.code() == Rule) \
+        return isa_column_kernel<Rule>();
+    LIFE_KERNEL_RULES(PICK_RULE, )
+#undef PICK_RULE
+    return isa_column_kernel<any_rule>();
+}
+
+bool kernel_rule_baked(const LifeRule &rule)
+{
+#define BAKED_RULE(unused, Rule) \
+    if(rule.code() == Rule && Rule != any_rule) \
+        return true;
+    LIFE_KERNEL_RULES(BAKED_RULE, )
+#undef BAKED_RULE
+    return false;
+}
+
+#define INSTANTIATE(Halo) template BasicLifeStepFn<Halo> life_step_kernel<Halo>(const LifeRule &rule);
+LIFE_KERNEL_HALOS(INSTANTIATE)
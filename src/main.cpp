@@ -1,390 +1,245 @@
 #include <SDL2/SDL.h>
+#include <limits.h>
 #include <iostream>
-#include <unistd.h>
-#include "chunks.cpp"
 
-class Offset2D : public Decorator<BoolGrid2D, BoolGrid2D>
-{
-    Vect2i offset;
-public:
-    Offset2D(BoolGrid2D *decorated, Vect2i offset) 
-    {
-        this->decorated = decorated;
-        this->offset = offset;
-    }
-    inline bool get(const Vect2i &pos) const override
-    {
-        return decorated->get(pos+offset);
-    }
-    inline void set(const Vect2i &pos, bool val) override
-    {
-        decorated->set(pos+offset, val);
-    }
-};
-
-void print_board_compact(const BoolGrid2D&, int);
-
-inline int sum_neighbours(const BoolGrid2D &c, const int x, const int y)
-{
-    int sum = 0;
-    for(int i = x-1; i<=x+1; i++)
-    {
-        for(int j = y-1; j<=y+1; j++)
-        {
-            sum += c.get({i, j}); 
-        }
-    }
-    sum -= c.get({x, y});
-    return sum;
-}
+#include "simulation.cpp"
+#include "renderer.hpp"
+#include "shard.hpp"
+#include "pipeline.hpp"
 
-inline int sum_triect(const BoolGrid2D &c, const int x, const int y)
+// Ticks life in an SDL window until it is closed or generations run out, drawing every generation.
+// LIFE_SDL is the video driver, "1" for the default one, "dummy" or "offscreen" on machines without a display.
+// LIFE_SDL_SAVE=frame.bmp writes the last frame out. Keys: arrows pan, +/- zoom, d switches any/density shading.
+template<class Chunk>
+int run_sdl(BasicBoolChunkLoader<Chunk> *life, const char *driver, const int generations, WorkStealingPool &pool)
 {
-    return c.get({x, y - 1}) + c.get({x, y}) + c.get({x, y + 1});
-}
-
-inline void conways_rules(BoolGrid2D &to, const BoolGrid2D &from, const int sum, const int x, const int y)
-{
-    if(sum < 2)
-        to.set({x, y}, 0);
-    else if (sum == 2)
-        to.set({x, y}, from.get({x, y}));
-    else if(sum == 3)
-        to.set({x, y}, 1);
-    else //if(sum > 3)
-        to.set({x, y}, 0);
-}
-
-void process_chunk_insides_v2(const UnpackedBoolChunk &from, UnpackedBoolChunk &result)
-{
-    int triect[BoolChunk::side_len_b];
-    //setup, its fucked up bcs or the rolling buffer
-    for(int x = 0; x < BoolChunk::side_len_b; x++)
+    if(strcmp(driver, "1") != 0)
+        setenv("SDL_VIDEODRIVER", driver, 1);
+    if(SDL_Init(SDL_INIT_VIDEO) != 0)
     {
-        triect[x] = from.get({x, 0}) * 2 + from.get({x, 1});
+        std::cerr << "SDL_Init: " << SDL_GetError() << '\n';
+        return 1;
     }
-    for(int y = 1; y < BoolChunk::side_len_b - 1; y++)
+    int status = 0;
     {
-        for(int x = 1; x < BoolChunk::side_len_b - 1; x++)
+        SdlView view("Life", 1024, 768);
+        if(!view.is_open())
         {
-            // rolling buffer
-            triect[x] += from.get({x, y + 1}) - from.get({x, y - 1});
-            int sum = triect[x - 1] + triect[x] + triect[x + 1];
-            if(sum == 0) // if completely empty
-            {
-                result.set({x, y}, 0);
-                continue;
-            }
-            sum -= from.get({x, y});
-            conways_rules(result, from, sum, x, y);
+            std::cerr << "SDL window: " << SDL_GetError() << '\n';
+            SDL_Quit();
+            return 1;
         }
-    }
-}
-
-// Iteration over chunk insides, thus removing cross-chunk reads (cache miss)
-void process_chunk_insides(const UnpackedBoolChunk &from, UnpackedBoolChunk &result)
-{
-    for(int y = 1; y < BoolChunk::side_len_b - 1; y++)
-    {
-        // setup
-        auto sum_triect = [&](int x, int y) -> int
+        // zoom < 0 is 2^-zoom pixels per cell, stretched by SdlView, > 0 is 2^zoom cells per pixel
+        int zoom = -1;
+        Reduce reduce = Reduce::any;
+        int window_w = 0, window_h = 0;
+        view.size(window_w, window_h);
+        ChunkRenderer frame(window_w >> 1, window_h >> 1);
+        Vect2i centre;
+        bool quit = false;
+        for(int i = 0; i != generations && !quit; i++)
         {
-            return from.get({x, y - 1}) + from.get({x, y}) + from.get({x, y + 1});
-        };
-        int triect[3], triect_iter = 0;
-        triect[1] = sum_triect(0, y);
-        triect[2] = sum_triect(1, y);
-        for(int x = 1; x < BoolChunk::side_len_b - 1; x++)
-        {
-            // rolling buffer
-            triect[triect_iter++] = sum_triect(x + 1, y);
-            if(triect_iter > 2)
-                triect_iter = 0;
-            int sum = triect[0] + triect[1] + triect[2];
-            if(sum == 0) // if completely empty
+            SDL_Event event;
+            while(SDL_PollEvent(&event))
             {
-                if(result.get({x, y}) == 1)
-                    result.set({x, y}, 0);
-                continue;
+                if(event.type == SDL_QUIT)
+                    quit = true;
+                else if(event.type == SDL_KEYDOWN)
+                {
+                    // an eighth of the screen per press, zoom is capped so it fits in an int
+                    const int step = std::max<int64_t>(1, (int64_t)(window_w >> 3) >> std::max(0, -zoom) << std::max(0, zoom));
+                    switch (event.key.keysym.sym)
+                    {
+                    case SDLK_ESCAPE:
+                    case SDLK_q:
+                        quit = true;
+                        break;
+                    case SDLK_LEFT:
+                        centre.x -= step;
+                        break;
+                    case SDLK_RIGHT:
+                        centre.x += step;
+                        break;
+                    case SDLK_UP:
+                        centre.y -= step;
+                        break;
+                    case SDLK_DOWN:
+                        centre.y += step;
+                        break;
+                    case SDLK_PLUS:
+                    case SDLK_EQUALS:
+                        zoom = std::max(-4, zoom - 1);
+                        break;
+                    case SDLK_MINUS:
+                        // no further than a window of cells still fits in an int, coordinates are ints
+                        if(zoom < ChunkRenderer::max_zoom
+                            && (int64_t)std::max(window_w, window_h) << std::max(0, zoom + 1) <= INT_MAX / 2)
+                            zoom++;
+                        break;
+                    case SDLK_d:
+                        reduce = reduce == Reduce::any ? Reduce::density : Reduce::any;
+                        break;
+                    }
+                }
             }
-            sum -= from.get({x, y});
-            conways_rules(result, from, sum, x, y);
+            view.size(window_w, window_h);
+            const int pixels_w = std::max(1, window_w >> std::max(0, -zoom)), pixels_h = std::max(1, window_h >> std::max(0, -zoom));
+            if(pixels_w != frame.surface()->w || pixels_h != frame.surface()->h)
+                frame.resize(pixels_w, pixels_h);
+            const int cells_shift = std::max(0, zoom);
+            const Vect2i corner = {(int)(centre.x - ((int64_t)pixels_w << cells_shift) / 2),
+                (int)(centre.y - ((int64_t)pixels_h << cells_shift) / 2)};
+            frame.render(*life, corner, cells_shift, reduce);
+            view.show(frame);
+            run_simulation(life, 0, 1, false, 64, Vect2i(), false, &pool, false);
         }
-    }
-}
-
-// stores sum of 3 cells in a rolling buffer, re-using read data 2/3rds of the time
-// 1010
-// 0011 
-// 0100
-void print_board_compact(const BoolGrid2D &c, int viewport_size);
-
-void tick_optimized(BoolChunkLoader &from, BoolChunkLoader &to)
-{
-    auto map = from.getChunkMap();
-    auto to_map = to.getChunkMap();
-    // iterate over all chunks
-    for(auto iter = map.begin(); iter != map.end(); ++iter)
-    {
-        const Vect2i &chunk_pos = iter->first;
-        const BoolChunk &chunk = *iter->second;
-        static const int max = BoolChunk::side_len_b - 1;
-        UnpackedBoolChunk result;
-        auto process_edge = [&](int xoffset, int yoffset, int dx, int dy, BoolGrid2D& to)
-        {
-            auto sum_triect = [&](int x, int y) -> int
-            {
-                return from.get({x - dy, y - dx}) + from.get({x, y}) + from.get({x + dy, y + dx});
-            };
-            int x = xoffset;
-            int y = yoffset;
-            int triect[3], triect_iter = 0;
-            triect[1] = sum_triect(x - dx, y - dy);
-            triect[2] = sum_triect(x, y);
-            for (int i = 0; i < BoolChunk::side_len_b; i++)
-            {   
-                x = xoffset + i * dx;
-                y = yoffset + i * dy;
-                triect[triect_iter++] = sum_triect(x + dx, y + dy);
-                if(triect_iter > 2)
-                    triect_iter = 0;
-                int sum = triect[0] + triect[1] + triect[2];
-                //if(sum == 0 && to.get({x, y}) == 0) // skip
-                //    continue;
-                sum -= from.get({x,y});
-                conways_rules(to, from, sum, x, y);
-            }
-        };
-        // skip
-        if(chunk.live_cells != 0)
+        const char *save = getenv("LIFE_SDL_SAVE");
+        if(save && SDL_SaveBMP(frame.surface(), save) != 0)
         {
-            // load/wake up neighbours
-            process_edge(chunk_pos.x           , chunk_pos.y -1    , 1, 0, to); // up , 0, -1
-            process_edge(chunk_pos.x           , chunk_pos.y + max + 1, 1, 0, to); // down , 0, 1
-            process_edge(chunk_pos.x - 1       , chunk_pos.y       , 0, 1, to); // left , -1, 0
-            process_edge(chunk_pos.x + max + 1 , chunk_pos.y       , 0, 1, to); // right , 1, 0
-            // for insides
-            process_chunk_insides(from.get_unpacked_chunk(chunk_pos), result);
+            std::cerr << "SDL_SaveBMP: " << SDL_GetError() << '\n';
+            status = 1;
         }
-        // for inside edges
-        Offset2D result_decorator(&result, {-chunk_pos.x, -chunk_pos.y}); //dumb
-        process_edge(chunk_pos.x       , chunk_pos.y      , 1, 0, result_decorator); // up , 0, -1
-        process_edge(chunk_pos.x       , chunk_pos.y + max, 1, 0, result_decorator); // down , 0, 1
-        process_edge(chunk_pos.x       , chunk_pos.y      , 0, 1, result_decorator); // left , -1, 0
-        process_edge(chunk_pos.x + max , chunk_pos.y      , 0, 1, result_decorator); // right , 1, 0
-        to.set_unpacked_chunk(chunk_pos, result);
     }
+    SDL_Quit();
+    return status;
 }
 
-    // Diehard OLD
-    //arr[front][11][13] = 1;
-    //arr[front][12][13] = 1;
-    //arr[front][12][14] = 1;
-    //arr[front][16][14] = 1;
-    //arr[front][17][14] = 1;
-    //arr[front][18][14] = 1;
-    //arr[front][17][12] = 1;
-    // TODO easier seed inpt, file or text or mouse
-    // Die harder
-    //arr[front][16][16] = 1;
-    //arr[front][17][16] = 1;
-    //arr[front][17][17] = 1;
-    //arr[front][21][17] = 1;
-    //arr[front][22][17] = 1;
-    //arr[front][23][17] = 1;
-    //arr[front][22][15] = 1;
-
-void set_acorn(BoolGrid2D &&c)
+// Runs the cells around the origin on a fixed width x height board, printing every 100 generations.
+// LIFE_EDGE=dead makes it a bounded board instead of a torus.
+template<class Chunk>
+int run_dense(BasicBoolChunkLoader<Chunk> *life, const char *size, const int generations, WorkStealingPool &pool)
 {
-    // Acorn
-    c.set(Vect2i(0,2), 1);
-    c.set(Vect2i(1,4), 1);
-    c.set(Vect2i(2,1), 1);
-    c.set(Vect2i(2,2), 1);
-    c.set(Vect2i(2,5), 1);
-    c.set(Vect2i(2,6), 1);
-    c.set(Vect2i(2,7), 1);
-}
-
-void set_acorn(BoolGrid2D &c)
-{
-    // Acorn
-    c.set(Vect2i(0,2), 1);
-    c.set(Vect2i(1,4), 1);
-    c.set(Vect2i(2,1), 1);
-    c.set(Vect2i(2,2), 1);
-    c.set(Vect2i(2,5), 1);
-    c.set(Vect2i(2,6), 1);
-    c.set(Vect2i(2,7), 1);
-}
-
-void set_glider(BoolGrid2D &&c)
-{
-    // Glider
-    c.set(Vect2i(2,1), 1);
-    c.set(Vect2i(3,2), 1);
-    c.set(Vect2i(1,3), 1);
-    c.set(Vect2i(2,3), 1);
-    c.set(Vect2i(3,3), 1);
-}
-
-void set_glider_b(BoolGrid2D &&c)
-{
-    // Glider
-    c.set(Vect2i(1,2), 1);
-    c.set(Vect2i(2,3), 1);
-    c.set(Vect2i(3,1), 1);
-    c.set(Vect2i(3,2), 1);
-    c.set(Vect2i(3,3), 1);
-}
-
-// Gosper glider gun
-//x = 36, y = 9, rule = B3/S23, but the rule is always Life so...
-//24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$2o8bo3bob2o4b
-//obo$10bo5bo7bo$11bo3bo$12b2o!
-
-void print_board_compact(const BoolGrid2D &c, int viewport_size)
-{
-    printf("\033c");
-
-    for(int i = 0; i < viewport_size; i++)
-    {
-        std::cout<<"-";
-    }
-    std::cout<<"\n";
-    for(int y = 0; y<viewport_size; y+=2)
+    int width = 0, height = 0;
+    if(sscanf(size, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
     {
-        std::cout<<"|";
-        for(int x = 0; x<viewport_size; x++)
-        {
-            int opcode = c.get({x,y})+c.get({x,y+1})*2;
-            switch (opcode)
-            {
-            case 0:
-                std::cout<<' ';
-                break;
-            case 1:
-                std::cout<<'\'';
-                break;
-            case 2:
-                std::cout<<'.';
-                break;
-            case 3:
-                std::cout<<':';
-                break;
-            default:
-                std::cout<<'X';
-            }
-        }
-        std::cout<<"|\n";
+        std::cerr << "LIFE_TORUS " << size << " is not WxH\n";
+        return 1;
     }
-    for(int i = 0; i < viewport_size; i++)
+    const char *edge_env = getenv("LIFE_EDGE");
+    const Edge edge = edge_env && strcmp(edge_env, "dead") == 0 ? Edge::dead : Edge::wrap;
+    DenseGrid grid(width, height, edge, life->rule());
+    grid.copy_from(*life, {-width / 2, -height / 2});
+    const int view = std::min(64, std::min(width, height));
+    for(int i = 0; i < generations; i += 100)
     {
-        std::cout<<"-";
+        print_board_compact(Offset2D(&grid, {(width - view) / 2, (height - view) / 2}), view);
+        grid.step(std::min(100, generations - i), &pool);
     }
-    std::cout<<"\n";
+    print_board_compact(Offset2D(&grid, {(width - view) / 2, (height - view) / 2}), view);
+    std::cout << "Final live count: " << grid.population() << '\n';
+    return 0;
 }
 
-//FIXME
-void cull(BoolChunkLoader *front, BoolChunkLoader *back)
+template<int Shift>
+int run(int argc, char **argv)
 {
-    auto map = front->getChunkMap();
-    std::vector<Vect2i> to_delete;
-    for (auto iter = map.begin(); iter != map.end(); )
+    typedef BasicBoolChunk<Shift> Chunk;
+    BasicBoolChunkLoader<Chunk>* start = new BasicBoolChunkLoader<Chunk>;
+    //set_glider(Offset2D(start, {0, 0}));
+    //set_vertical_pattern(Offset2D(start, {0, 0}));
+    //set_gosper_gun(*start);
+    uint64_t first_generation = 0; // where a snapshot left off
+    if(argc > 1) // main pattern.rle or main checkpoint.snap
     {
-        if (iter->second->live_cells == 0)
-            to_delete.push_back(iter->first);
-        ++iter;
+        const std::string path = argv[1];
+        Snapshot snapshot;
+        if(snapshot.open(path))
+            first_generation = snapshot.restore_to(*start);
+        else if(!load_rle(*start, argv[1]))
+            return 1;
     }
-    while(!to_delete.empty())
+    else
+        set_acorn(Offset2D(start, {0, 0}));
+    // LIFE_RULE=B36/S23 and so on, over the rule of the file
+    const char *rule_env = getenv("LIFE_RULE");
+    if(rule_env)
     {
-        front->kill(to_delete.back());
-        back->kill(to_delete.back());
-        to_delete.pop_back();
-    }
-}
-
-BoolChunkLoader* run_simulation(
-    BoolChunkLoader* start,
-    float tick_delay = 0.5,
-    int simulation_len = -1,
-    bool graphics = true,
-    int viewport_size = 64,
-    Vect2i viewport_offset = Vect2i(-32, -32),
-    bool manual = false
-    )
-{
-    BoolChunkLoader *front = start, *back = new BoolChunkLoader;
-    for(int i = 0; i != simulation_len; i++)
-    {
-        if(graphics)
-            print_board_compact(Offset2D(front, viewport_offset), viewport_size);
-        else if(i % 10 == 0)
-            std::cout<<"Generation, chunks: "<< i << ", " << back->getChunkMap().size() <<'\n';
-        if(manual)
-            std::cin.ignore(9999, '\n');
-        tick_optimized(*front, *back);
-        BoolChunkLoader *swap = front;
-        front = back;
-        back = swap;
-        cull(front, back);
-        if(tick_delay && !manual)
-            usleep(tick_delay * (1<<20));
-    }
-    delete back;
-    return front;
-}
-
-// Very easy to verify processing integrity
-void set_vertical_pattern(BoolGrid2D&& chunk) {
-    // Create a pattern of vertical lines: live line, two empty lines, repeating
-    for (int x = -10; x < 100; x += 3) {
-        for (int y = -10; y < 100; ++y) {
-            // Set a vertical line at every 3rd x position
-            chunk.set({x, y}, true);
-            chunk.set({x + 1, y}, false);
-            chunk.set({x + 2, y}, false);
+        LifeRule rule;
+        if(!LifeRule::parse(rule_env, rule))
+        {
+            std::cerr << "LIFE_RULE " << rule_env << " is not a B/S rule, or has B0\n";
+            return 1;
         }
+        start->set_rule(rule);
     }
-}
-
-int main(int argc, char **argv)
-{
-    BoolChunkLoader* start = new BoolChunkLoader;
-    //set_glider(Offset2D(start, {0, 0}));
-    //set_vertical_pattern(Offset2D(start, {0, 0}));
-    set_acorn(Offset2D(start, {0, 0}));
+    WorkStealingPool pool;
+    const char *sdl_driver = getenv("LIFE_SDL");
+    if(sdl_driver)
+        return run_sdl(start, sdl_driver, 100000, pool);
+    // LIFE_TORUS=WxH runs on a dense board of that size instead of the infinite one
+    const char *torus = getenv("LIFE_TORUS");
+    if(torus)
+        return run_dense(start, torus, 100000, pool);
+    // LIFE_HASHLIFE=N jumps N generations at once instead of ticking through them
+    const char *hashlife_env = getenv("LIFE_HASHLIFE");
+    if(hashlife_env)
+        return run_jump(start, strtoull(hashlife_env, nullptr, 10));
     print_board_compact(Offset2D(start, {0,0}), 64);
     usleep(1 * (1<<20));
-    auto result = run_simulation(start, 0, 100000, 0, 64, {0, 0}, 0);
+    // LIFE_BLOCK=K advances K generations per tick, up to 16 for 32 cell chunks and 32 for bigger ones
+    const char *block_env = getenv("LIFE_BLOCK");
+    const int block = block_env ? std::max(1, atoi(block_env)) : 1;
+    // LIFE_SHARDS=N splits the universe over N worker processes, see ShardCoordinator
+    const char *shards_env = getenv("LIFE_SHARDS");
+    // LIFE_PIPELINE=1 draws the viewport on a thread of its own while the ticks run flat out, LIFE_PIPELINE=stats
+    // prints progress lines instead. LIFE_CHECKPOINT=life.snap saves every LIFE_CHECKPOINT_EVERY generations, 1000 if
+    // not set, from another thread again
+    const char *pipeline_env = getenv("LIFE_PIPELINE");
+    const char *checkpoint_env = getenv("LIFE_CHECKPOINT");
+    const char *every_env = getenv("LIFE_CHECKPOINT_EVERY");
+    BasicBoolChunkLoader<Chunk> *result;
+    if(shards_env)
+        result = run_sharded(start, std::max(1, atoi(shards_env)), 100000, block, 8, true, first_generation);
+    else if(pipeline_env || checkpoint_env)
+        result = run_pipelined(start, 100000, pipeline_env && strcmp(pipeline_env, "stats") != 0, 64, {0, 0}, &pool,
+            true, block, checkpoint_env ? checkpoint_env : "", every_env ? std::max(1, atoi(every_env)) : 1000, 1.0 / 30,
+            first_generation);
+    else
+        result = run_simulation(start, 0, 100000, 0, 64, {0, 0}, 0, &pool, true, block, first_generation);
+    if(!result)
+    {
+        std::cerr << "A shard worker failed\n";
+        return 1;
+    }
     print_board_compact(Offset2D(result, {0, 0}), 64);
-    auto map = result->getChunkMap();
-    int live_cnt = 0;
     int i = 0;
-    for(auto iter = map.begin(); iter != map.end(); ++iter)
+    for(const auto entry : result->loaded_chunks())
     {
-        print_board_compact(*iter->second, 32);
-        std::cout<<"N: " << i++ << ", dead?: " << iter->second->live_cells <<'\n';
+        print_board_compact(entry.chunk, Chunk::side_len_b);
+        std::cout<<"N: " << i++ << ", dead?: " << entry.chunk.live_cells <<'\n';
         usleep(0.2 * (1<<20));
     }
     print_board_compact(Offset2D(result, {0, 0}), 64);
-    for(auto iter = map.begin(); iter != map.end(); ++iter)
-        live_cnt += iter->second->live_cells;
-    std::cout << "Final live count: " << live_cnt << '\n';
-    std::cout << "Final num chunks: " << map.size() << '\n';
-    live_cnt = 0;
-    for(auto iter = map.begin(); iter != map.end(); ++iter)
-        live_cnt += iter->second->live_cells ? 0 : 1;
-    std::cout << "Final num dead chunks: " << live_cnt << '\n';
-    live_cnt = 0;
-    for(auto iter = map.begin(); iter != map.end(); ++iter)
+    // counted as the ticks went
+    std::cout << "Final live count: " << result->population() << '\n';
+    std::cout << "Final num chunks: " << result->chunk_count() << '\n';
+    std::cout << "Final num dead chunks: " << result->chunk_count() - result->live_chunk_count() << '\n';
+    const CellBox box = result->bounding_box();
+    if(!box.empty())
+        std::cout << "Final bounding box: " << box.min_x << ',' << box.min_y << " to " << box.max_x << ',' << box.max_y << '\n';
+    int live_cnt = 0;
+    for(const auto entry : result->loaded_chunks())
     {
-        live_cnt += iter->second->live_cells > 10 ? 1 : 0;
+        live_cnt += entry.chunk.live_cells > 10 ? 1 : 0;
     }
     std::cout << "Final num simple chunks: " << live_cnt << '\n';
     return 0;
 }
 
+int main(int argc, char **argv)
+{
+    // LIFE_CHUNK_SIDE=32|64|128|256, big chunks pay off on dense patterns, small ones on sparse
+    const char *side_env = getenv("LIFE_CHUNK_SIDE");
+    const int side = side_env ? atoi(side_env) : 32;
+    int status = 1;
+    if(!with_chunk_side(side, [&](auto shift) { status = run<decltype(shift)::value>(argc, argv); }))
+    {
+        std::cerr << "LIFE_CHUNK_SIDE must be 32, 64, 128 or 256\n";
+        return 1;
+    }
+    return status;
+}
+
 // Unrelated: whs: 29y not write in C?
 // it has strict types, strict syntax, just write endpoints here
 
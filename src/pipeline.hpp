@@ -0,0 +1,308 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "simulation.cpp"
+#include "spsc_ring.hpp"
+
+// One generation as the consumers of a LifePipeline see it, never written after it is published.
+// The view and chunks are only there when a consumer it went to asked for them.
+template<class Chunk>
+struct LifeFrame
+{
+    uint64_t generation = 0;
+    int64_t population = 0;
+    int64_t live_chunks = 0;
+    size_t chunk_count = 0; // no bounding box, that can take a walk over the chunks
+    LifeRule rule;
+    Vect2i view_pos;
+    int view_width = 0, view_height = 0;
+    std::vector<uint64_t> view; // as read_region() writes it, (view_width + 63) / 64 words per row
+    std::vector<std::pair<Vect2i, Chunk>> chunks; // every chunk with live cells
+};
+
+template<class Chunk>
+class LifePipeline
+{
+    /**
+     * @brief Hands generations from the thread that ticks to consumer threads, without the tick ever waiting on them
+     * Each consumer has its own SpscRing of frames and its own thread. publish() builds one frame for all the
+     * consumers due a frame that have room left, copying out only what those want, and skips the ones that are
+     * full, so a slow consumer gets the frames it keeps up with and the ticks go on at full speed.
+     */
+public:
+    typedef std::shared_ptr<const LifeFrame<Chunk>> FramePtr;
+    typedef std::function<void(const LifeFrame<Chunk>&)> ConsumerFn;
+
+    struct ConsumerStats
+    {
+        uint64_t taken = 0; // frames handed to the consumer
+        uint64_t dropped = 0; // frames it was due but skipped, its ring was full
+    };
+
+private:
+    struct Consumer
+    {
+        ConsumerFn fn;
+        uint64_t every;
+        bool wants_view, wants_chunks;
+        SpscRing<FramePtr> ring;
+        std::thread thread;
+        uint64_t next = 0; // generation the next frame is due, producer side like stats
+        ConsumerStats stats;
+
+        Consumer(ConsumerFn fn, const uint64_t every, const bool wants_view, const bool wants_chunks, const size_t capacity)
+            : fn(std::move(fn)), every(std::max<uint64_t>(1, every)), wants_view(wants_view), wants_chunks(wants_chunks),
+            ring(capacity)
+        {
+        }
+    };
+
+    std::vector<std::unique_ptr<Consumer>> consumers;
+    std::vector<Consumer*> due; // publish() scratch
+    std::atomic<bool> finished{false};
+    bool started = false;
+    Vect2i view_pos;
+    int view_width = 0, view_height = 0;
+
+    // Consumer thread, spins a little on an empty ring, then naps so an idle consumer costs next to nothing
+    void consume(Consumer &consumer)
+    {
+        FramePtr frame;
+        int idle = 0;
+        for(;;)
+        {
+            // read first, whatever was pushed before finish() is in the ring once finished is true
+            const bool last = finished.load(std::memory_order_acquire);
+            if(consumer.ring.pop(frame))
+            {
+                consumer.fn(*frame);
+                frame.reset();
+                idle = 0;
+                continue;
+            }
+            if(last)
+                return;
+            if(idle++ < 64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+public:
+    LifePipeline() = default;
+    LifePipeline(const LifePipeline&) = delete;
+    LifePipeline& operator=(const LifePipeline&) = delete;
+
+    ~LifePipeline()
+    {
+        finish();
+    }
+
+    // Cells the frames carry for consumers that want a view
+    void set_view(const Vect2i &pos, const int width, const int height)
+    {
+        view_pos = pos;
+        view_width = std::max(1, width);
+        view_height = std::max(1, height);
+    }
+
+    // fn gets the frames of generation 0, every, 2 * every and so on, on its own thread, with up to capacity frames
+    // waiting. Only before start(). Returns the index for stats()
+    size_t add_consumer(ConsumerFn fn, const uint64_t every = 1, const bool wants_view = false,
+        const bool wants_chunks = false, const size_t capacity = 4)
+    {
+        consumers.emplace_back(new Consumer(std::move(fn), every, wants_view, wants_chunks, capacity));
+        return consumers.size() - 1;
+    }
+
+    void start()
+    {
+        if(started)
+            return;
+        started = true;
+        for(auto &consumer : consumers)
+            consumer->thread = std::thread(&LifePipeline::consume, this, std::ref(*consumer));
+    }
+
+    // From the ticking thread, between ticks. Never blocks, a frame is only built if some consumer takes it
+    void publish(const ChunkLoader<Chunk> &life, const uint64_t generation)
+    {
+        bool view = false, chunks = false;
+        due.clear();
+        for(auto &consumer : consumers)
+        {
+            if(generation < consumer->next)
+                continue;
+            consumer->next = (generation / consumer->every + 1) * consumer->every;
+            if(consumer->ring.full())
+            {
+                consumer->stats.dropped++;
+                continue;
+            }
+            due.push_back(consumer.get());
+            view |= consumer->wants_view;
+            chunks |= consumer->wants_chunks;
+        }
+        if(due.empty())
+            return;
+
+        std::shared_ptr<LifeFrame<Chunk>> frame(new LifeFrame<Chunk>);
+        frame->generation = generation;
+        frame->population = life.population();
+        frame->live_chunks = life.live_chunk_count();
+        frame->chunk_count = life.chunk_count();
+        frame->rule = life.rule();
+        if(view && view_width > 0)
+        {
+            frame->view_pos = view_pos;
+            frame->view_width = view_width;
+            frame->view_height = view_height;
+            const size_t stride = (view_width + 63) / 64;
+            frame->view.resize(stride * view_height);
+            life.read_region(view_pos, view_width, view_height, frame->view.data(), stride);
+        }
+        if(chunks)
+        {
+            frame->chunks.reserve(frame->live_chunks);
+            for(const auto entry : life.loaded_chunks())
+            {
+                if(entry.chunk.live_cells != 0)
+                    frame->chunks.emplace_back(entry.pos, entry.chunk);
+            }
+        }
+
+        const FramePtr shared = std::move(frame);
+        for(Consumer *consumer : due)
+        {
+            FramePtr copy = shared; // only the consumer pops, so there is still room
+            consumer->ring.push(std::move(copy));
+            consumer->stats.taken++;
+        }
+    }
+
+    // Lets the consumers work through what is left in their rings and joins them, no publish() after this
+    void finish()
+    {
+        finished.store(true, std::memory_order_release);
+        for(auto &consumer : consumers)
+        {
+            if(consumer->thread.joinable())
+                consumer->thread.join();
+        }
+    }
+
+    // Only from the ticking thread, or after finish()
+    const ConsumerStats& stats(const size_t consumer) const
+    {
+        return consumers[consumer]->stats;
+    }
+};
+
+// Writes the chunks of a frame, one that a consumer wanting chunks got, to path as a Snapshot. False if that failed
+template<class Chunk>
+bool save_frame(const LifeFrame<Chunk> &frame, const std::string &path)
+{
+    return Snapshot::save_chunks(frame.chunks, frame.rule, path, frame.generation);
+}
+
+// run_simulation() with the drawing, progress lines and checkpoints each on their own thread, fed frames through a
+// LifePipeline, so the ticks never wait on the terminal or the disk. Frames are drawn at most every frame_delay
+// seconds and the ones in between are skipped. With checkpoint set, life is saved there every checkpoint_every
+// generations, skipping the ones due while the last is still being written, and once more at the end, before this
+// returns, unless the last generation was already saved.
+template<class Chunk>
+BasicBoolChunkLoader<Chunk>* run_pipelined(
+    BasicBoolChunkLoader<Chunk>* life,
+    int simulation_len = -1,
+    bool graphics = true,
+    int viewport_size = 64,
+    Vect2i viewport_offset = Vect2i(-32, -32),
+    WorkStealingPool *pool = nullptr,
+    bool progress = true,
+    int block = 1,
+    const std::string &checkpoint = std::string(),
+    uint64_t checkpoint_every = 1000,
+    float frame_delay = 1.0 / 30,
+    uint64_t first_generation = 0 // generation life is at, for a run restored from a snapshot
+    )
+{
+    // before the pipeline, so it outlives the consumer threads
+    std::unique_ptr<TerminalRenderer> screen(graphics ? new TerminalRenderer(viewport_size, viewport_size) : nullptr);
+    uint64_t saved = 0, saved_generation = 0; // by the checkpoint thread, read after finish()
+    LifePipeline<Chunk> pipeline;
+    if(graphics)
+    {
+        pipeline.set_view(viewport_offset, viewport_size, viewport_size);
+        pipeline.add_consumer([&](const LifeFrame<Chunk> &frame)
+        {
+            screen->render_rows(frame.view.data());
+            if(frame_delay > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(frame_delay * 1e6)));
+        }, 1, true);
+    }
+    else if(progress)
+    {
+        pipeline.add_consumer([](const LifeFrame<Chunk> &frame)
+        {
+            std::cout << "Generation, population, chunks: " << frame.generation << ", " << frame.population << ", "
+                << frame.chunk_count << '\n';
+        }, 100);
+    }
+    size_t saver = 0;
+    if(!checkpoint.empty())
+    {
+        saver = pipeline.add_consumer([&](const LifeFrame<Chunk> &frame)
+        {
+            if(save_frame(frame, checkpoint))
+            {
+                saved++;
+                saved_generation = frame.generation;
+            }
+            else
+                std::cerr << "Could not write checkpoint " << checkpoint << '\n';
+        }, checkpoint_every, false, true, 1);
+    }
+    pipeline.start();
+    uint64_t generation = first_generation;
+    pipeline.publish(*life, generation);
+    for(int i = 0, done = 0; i != simulation_len; i += done)
+    {
+        const int generations = simulation_len < 0 ? block : std::min(block, simulation_len - i);
+        if(pool)
+            done = tick_parallel(*life, *pool, generations);
+        else
+            done = tick_bitwise(*life, generations);
+        life->cull();
+        PROFILE_GENERATIONS(done);
+        generation += done;
+        pipeline.publish(*life, generation);
+    }
+    pipeline.finish();
+    if(checkpoint.empty())
+        return life;
+    uint64_t failed = pipeline.stats(saver).taken - saved;
+    // the end of the run is not left to the skippable checkpoints, it is written here with the ticks stopped
+    if(saved == 0 || saved_generation != generation)
+    {
+        if(Snapshot::save(*life, checkpoint, generation))
+            saved++;
+        else
+        {
+            failed++;
+            std::cerr << "Could not write checkpoint " << checkpoint << '\n';
+        }
+    }
+    if(progress)
+        std::cout << "Checkpoints written, failed, skipped: " << saved << ", " << failed << ", "
+            << pipeline.stats(saver).dropped << '\n';
+    return life;
+}
@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "test_cells.hpp"
+
+// SpscRing on its own and across two threads, LifePipeline dropping frames for a slow consumer and finishing what is
+// queued, and run_pipelined() leaving the last generation in its checkpoint
+
+void check_ring()
+{
+    SpscRing<int> ring(3); // rounded up to 4
+    int item = 0;
+    bool ok = !ring.pop(item) && !ring.full();
+    for(int i = 0; i < 4; i++)
+        ok = ok && ring.push(int(i));
+    int spare = 99;
+    ok = ok && ring.full() && !ring.push(std::move(spare)) && spare == 99;
+    for(int i = 0; i < 4; i++)
+        ok = ok && ring.pop(item) && item == i;
+    check(ok && !ring.pop(item), "ring holds a power of 2, in order, push fails when full");
+
+    // a popped slot lets go of what it held
+    SpscRing<std::shared_ptr<int>> shared(2);
+    std::shared_ptr<int> value(new int(7)), out;
+    shared.push(std::shared_ptr<int>(value));
+    shared.pop(out);
+    out.reset();
+    check(value.use_count() == 1, "pop leaves the slot empty");
+
+    // every item once, in order, with both sides spinning on a small ring
+    static const int count = 1000000;
+    SpscRing<int> between(16);
+    std::thread producer([&]
+    {
+        for(int i = 0; i < count; i++)
+        {
+            while(!between.push(int(i)))
+                std::this_thread::yield();
+        }
+    });
+    ok = true;
+    for(int i = 0; i < count; i++)
+    {
+        while(!between.pop(item))
+            std::this_thread::yield();
+        ok = ok && item == i;
+    }
+    producer.join();
+    check(ok && !between.pop(item), "ring across threads");
+}
+
+void check_pipeline(const Cells &cells)
+{
+    BoolChunkLoader life;
+    set_cells(life, cells);
+    const Vect2i view_pos = {-20, -10};
+    const int view_width = 70, view_height = 30;
+    std::vector<uint64_t> generations_fast, generations_slow;
+    std::vector<std::vector<uint64_t>> views;
+    std::vector<size_t> chunk_counts;
+    LifePipeline<BoolChunk> pipeline;
+    pipeline.set_view(view_pos, view_width, view_height);
+    // takes everything it is given, every 3rd generation, with a view and the chunks
+    const size_t fast = pipeline.add_consumer([&](const LifeFrame<BoolChunk> &frame)
+    {
+        generations_fast.push_back(frame.generation);
+        views.push_back(frame.view);
+        chunk_counts.push_back(frame.chunks.size());
+    }, 3, true, true, 1024);
+    // one frame of room and slow, so most of the frames it is due get skipped
+    const size_t slow = pipeline.add_consumer([&](const LifeFrame<BoolChunk> &frame)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        generations_slow.push_back(frame.generation);
+    }, 1, false, false, 1);
+    pipeline.start();
+    const size_t stride = (view_width + 63) / 64;
+    std::vector<std::vector<uint64_t>> expected_views;
+    std::vector<size_t> expected_chunks;
+    for(uint64_t generation = 0; generation < 200; generation++)
+    {
+        if(generation % 3 == 0)
+        {
+            std::vector<uint64_t> rows(stride * view_height);
+            life.read_region(view_pos, view_width, view_height, rows.data(), stride);
+            expected_views.push_back(rows);
+            expected_chunks.push_back(life.live_chunk_count());
+        }
+        pipeline.publish(life, generation);
+        tick_bitwise(life);
+        life.cull();
+    }
+    pipeline.finish();
+
+    bool ok = generations_fast.size() == 67 && pipeline.stats(fast).taken == 67 && pipeline.stats(fast).dropped == 0;
+    for(size_t i = 0; ok && i < generations_fast.size(); i++)
+        ok = generations_fast[i] == i * 3 && views[i] == expected_views[i] && chunk_counts[i] == expected_chunks[i];
+    check(ok, "frames carry the view and live chunks of their generation");
+    // everything taken is consumed, finish() waits for it
+    ok = pipeline.stats(slow).taken == generations_slow.size() && pipeline.stats(slow).dropped > 0
+        && pipeline.stats(slow).taken + pipeline.stats(slow).dropped == 200;
+    for(size_t i = 1; ok && i < generations_slow.size(); i++)
+        ok = generations_slow[i] > generations_slow[i - 1];
+    check(ok, "slow consumer skips frames, finish drains the rest");
+}
+
+void check_checkpoint(const Cells &cells, const std::string &path)
+{
+    // checkpoints every 1000 generations and a run of 37 from 5, so only the one at the end can have the result
+    BoolChunkLoader life;
+    set_cells(life, cells);
+    run_pipelined(&life, 37, false, 64, Vect2i(), nullptr, false, 4, path, 1000, 0, 5);
+    Snapshot snapshot;
+    BoolChunkLoader restored;
+    check(snapshot.open(path) && snapshot.generation() == 42 && snapshot.restore_to(restored) == 42
+        && cells_of(restored) == cells_of(life), "last generation checkpointed");
+}
+
+int main()
+{
+    check_ring();
+    const Cells cells = soup({-40, -30}, 80, 35, 0x9E3779B97F4A7C15ull);
+    check_pipeline(cells);
+    char dir_template[] = "/tmp/pipeline_tests.XXXXXX";
+    if(!mkdtemp(dir_template))
+    {
+        check(false, "making a temporary directory");
+        return test_result();
+    }
+    const std::string dir = dir_template;
+    check_checkpoint(cells, dir + "/end.snap");
+    check(system(("rm -r " + dir).c_str()) == 0, "cleaning up");
+    return test_result();
+}
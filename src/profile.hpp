@@ -0,0 +1,202 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Where the time of a tick goes, see PROFILE_SCOPE
+enum class Phase
+{
+    collect, // finding the chunks to compute
+    halo, // unpacking the chunk and neighbour rows for the kernel
+    compute, // kernel
+    store, // packing results of loaded chunks back
+    border, // finding the neighbours of missing chunks around the live ones
+    alloc, // creating and linking chunks
+    cull,
+    recount, // going over the chunks again for the census, see ChunkLoader::population()
+    count
+};
+
+enum class Counter
+{
+    hot_hit, // get() served by the two chunk cache
+    hot_miss,
+    lookups, // map lookups
+    allocs,
+    frees,
+    computed, // chunks ran through the kernel
+    skipped, // unchanged chunks not computed
+    count
+};
+
+#ifdef LIFE_PROFILE
+
+class Profile
+{
+    /**
+     * @brief Cycle timers and event counters, built in with -DLIFE_PROFILE only
+     * Each thread adds to its own slots, so the hot paths never share a cache line or take a lock.
+     * run_simulation calls generations_done() after each tick, which every LIFE_PROFILE_EVERY (100) generations writes
+     * one line of JSON to LIFE_PROFILE_OUT (stdout) and starts counting again. Times are TSC cycles on x86, ns elsewhere.
+     */
+public:
+    struct Local
+    {
+        std::atomic<uint64_t> calls[(int)Phase::count] = {};
+        std::atomic<uint64_t> cycles[(int)Phase::count] = {};
+        std::atomic<uint64_t> counts[(int)Counter::count] = {};
+    };
+
+private:
+    std::mutex lock;
+    std::vector<std::unique_ptr<Local>> locals;
+    uint64_t generation = 0;
+    uint64_t dumped = 0; // generation of the last line
+    uint64_t every;
+    FILE *out;
+    uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+
+    Profile()
+    {
+        const char *every_env = getenv("LIFE_PROFILE_EVERY");
+        every = every_env ? std::max(1, atoi(every_env)) : 100;
+        const char *path = getenv("LIFE_PROFILE_OUT");
+        out = path ? fopen(path, "a") : nullptr;
+        if(!out)
+            out = stdout;
+        start_ticks = ticks();
+        start_time = std::chrono::steady_clock::now();
+    }
+
+    Local* add_local()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        locals.emplace_back(new Local);
+        return locals.back().get();
+    }
+
+    static inline void add(std::atomic<uint64_t> &slot, const uint64_t n)
+    {
+        // only the owning thread writes, no need for a locked add
+        slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void dump()
+    {
+        static const char *const phase_names[] = {"collect", "halo", "compute", "store", "border", "alloc", "cull",
+            "recount"};
+        static const char *const counter_names[] = {"hot_hit", "hot_miss", "lookups", "allocs", "frees", "computed", "skipped"};
+        static_assert(sizeof(phase_names) / sizeof(*phase_names) == (int)Phase::count, "Missing phase name");
+        static_assert(sizeof(counter_names) / sizeof(*counter_names) == (int)Counter::count, "Missing counter name");
+        uint64_t calls[(int)Phase::count] = {}, cycles[(int)Phase::count] = {}, counts[(int)Counter::count] = {};
+        std::lock_guard<std::mutex> guard(lock);
+        for(auto iter = locals.begin(); iter != locals.end(); ++iter)
+        {
+            Local &local = **iter;
+            for(int i = 0; i < (int)Phase::count; i++)
+            {
+                calls[i] += local.calls[i].exchange(0, std::memory_order_relaxed);
+                cycles[i] += local.cycles[i].exchange(0, std::memory_order_relaxed);
+            }
+            for(int i = 0; i < (int)Counter::count; i++)
+                counts[i] += local.counts[i].exchange(0, std::memory_order_relaxed);
+        }
+        // ticks per ns, measured over the whole run so far
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+        const double per_ns = ns > 0 ? (ticks() - start_ticks) / ns : 1;
+        fprintf(out, "{\"generation\": %llu, \"generations\": %llu", (unsigned long long)generation,
+            (unsigned long long)(generation - dumped));
+        dumped = generation;
+        for(int i = 0; i < (int)Phase::count; i++)
+        {
+            fprintf(out, ", \"%s\": {\"calls\": %llu, \"cycles\": %llu, \"ms\": %.3f}", phase_names[i],
+                (unsigned long long)calls[i], (unsigned long long)cycles[i], cycles[i] / per_ns / 1e6);
+        }
+        for(int i = 0; i < (int)Counter::count; i++)
+            fprintf(out, ", \"%s\": %llu", counter_names[i], (unsigned long long)counts[i]);
+        fprintf(out, "}\n");
+        fflush(out);
+    }
+
+public:
+    static Profile& instance()
+    {
+        static Profile profile;
+        return profile;
+    }
+
+    static inline uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static inline Local& local()
+    {
+        thread_local Local *mine = instance().add_local();
+        return *mine;
+    }
+
+    static inline void count(const Counter counter, const uint64_t n)
+    {
+        add(local().counts[(int)counter], n);
+    }
+
+    static inline void time(const Phase phase, const uint64_t cycles)
+    {
+        Local &mine = local();
+        add(mine.calls[(int)phase], 1);
+        add(mine.cycles[(int)phase], cycles);
+    }
+
+    // Between ticks only, the workers must be idle. A tick may be asked to count several generations,
+    // then a line covers every generation up to the first tick that reaches the next multiple of every
+    void generations_done(const uint64_t n)
+    {
+        generation += n;
+        if(generation / every != (generation - n) / every)
+            dump();
+    }
+};
+
+class ProfileScope
+{
+    Phase phase;
+    uint64_t start;
+public:
+    ProfileScope(const Phase phase) : phase(phase), start(Profile::ticks())
+    {
+    }
+    ~ProfileScope()
+    {
+        Profile::time(phase, Profile::ticks() - start);
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// Times the rest of the enclosing block
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(Phase::phase)
+#define PROFILE_COUNT(counter, n) Profile::count(Counter::counter, (n))
+#define PROFILE_GENERATIONS(n) Profile::instance().generations_done(n)
+
+#else
+
+#define PROFILE_SCOPE(phase)
+#define PROFILE_COUNT(counter, n)
+#define PROFILE_GENERATIONS(n)
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdint.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_cells.hpp"
+
+// read_region and write_region against the cells one at a time, at offsets that do not line up with chunks or words
+
+struct Rect
+{
+    Vect2i pos;
+    int width, height;
+};
+
+static const Rect rects[] = {
+    {{0, 0}, 32, 32}, // one whole chunk
+    {{-37, -5}, 1, 1},
+    {{-37, -5}, 63, 40},
+    {{3, 61}, 64, 3},
+    {{-70, -70}, 65, 97},
+    {{-100, -90}, 200, 170}, // more than the soup, so empty chunks and missing ones too
+};
+
+std::string name_of(const Rect &rect)
+{
+    return std::to_string(rect.width) + "x" + std::to_string(rect.height) + " at " + std::to_string(rect.pos.x) + ","
+        + std::to_string(rect.pos.y);
+}
+
+// Sum of live_cells, which write_region has to keep right
+int population(const BoolChunkLoader &life)
+{
+    int population = 0;
+    for(const auto entry : life.loaded_chunks())
+        population += entry.chunk.live_cells;
+    return population;
+}
+
+bool inside(const Rect &rect, const std::pair<int, int> &cell)
+{
+    return cell.first >= rect.pos.x && cell.second >= rect.pos.y && cell.first < rect.pos.x + rect.width
+        && cell.second < rect.pos.y + rect.height;
+}
+
+// A bitmap as read_region lays it out, one spare word per row that must be left alone
+std::vector<uint64_t> bitmap_of(const Cells &cells, const Rect &rect, const size_t stride)
+{
+    std::vector<uint64_t> rows(stride * rect.height, 0);
+    for(const auto &cell : cells)
+    {
+        if(!inside(rect, cell))
+            continue;
+        const int x = cell.first - rect.pos.x, y = cell.second - rect.pos.y;
+        rows[y * stride + x / 64] |= (uint64_t)1 << (x % 64);
+    }
+    return rows;
+}
+
+void check_read(const Cells &cells)
+{
+    BoolChunkLoader life;
+    set_cells(life, cells);
+    for(const Rect &rect : rects)
+    {
+        const size_t stride = (rect.width + 63) / 64 + 1;
+        std::vector<uint64_t> rows(stride * rect.height, ~(uint64_t)0);
+        life.read_region(rect.pos, rect.width, rect.height, rows.data(), stride);
+        // the spare words are expected to come back untouched
+        std::vector<uint64_t> expected = bitmap_of(cells, rect, stride);
+        for(int y = 0; y < rect.height; y++)
+            expected[y * stride + stride - 1] = ~(uint64_t)0;
+        check(rows == expected, "read_region " + name_of(rect));
+    }
+}
+
+void check_write(const Cells &cells, const BlitMode mode)
+{
+    const std::string what = mode == BlitMode::merge ? "merge " : "overwrite ";
+    uint64_t seed = 0x2545F4914F6CDD1Dull;
+    for(const Rect &rect : rects)
+    {
+        const Cells written = soup(rect.pos, std::max(rect.width, rect.height), 40, seed++);
+        BoolChunkLoader life;
+        set_cells(life, cells);
+        const size_t stride = (rect.width + 63) / 64;
+        const std::vector<uint64_t> rows = bitmap_of(written, rect, stride);
+        life.write_region(rect.pos, rect.width, rect.height, rows.data(), stride, mode);
+        Cells expected;
+        for(const auto &cell : cells)
+        {
+            if(mode == BlitMode::merge || !inside(rect, cell))
+                expected.insert(cell);
+        }
+        for(const auto &cell : written)
+        {
+            if(inside(rect, cell))
+                expected.insert(cell);
+        }
+        check(cells_of(life) == expected && population(life) == (int)expected.size()
+            && life.population() == (int64_t)expected.size(), what + name_of(rect));
+    }
+    // nothing to put, nothing to load
+    BoolChunkLoader life;
+    const size_t loaded = life.chunk_count();
+    const std::vector<uint64_t> zeros(4 * 100, 0);
+    life.write_region({-70, -30}, 200, 100, zeros.data(), 4, mode);
+    check(life.chunk_count() == loaded, what + "of zeros loads no chunks");
+}
+
+// loaded_chunks() goes through every chunk once, which the other checks lean on through cells_of()
+void check_range(const Cells &cells)
+{
+    BoolChunkLoader life;
+    set_cells(life, cells);
+    std::set<std::pair<int, int>> seen;
+    size_t visits = 0;
+    for(const auto entry : life.loaded_chunks())
+    {
+        visits++;
+        seen.insert({entry.pos.x, entry.pos.y});
+    }
+    check(visits == life.chunk_count() && seen.size() == visits && life.loaded_chunks().size() == visits,
+        "loaded_chunks visits every chunk once");
+}
+
+int main()
+{
+    // across the origin, so negative coordinates and chunks on both sides of it get tested
+    const Cells cells = soup({-80, -60}, 150, 35, 0x9E3779B97F4A7C15ull);
+    check_range(cells);
+    check_read(cells);
+    check_write(cells, BlitMode::overwrite);
+    check_write(cells, BlitMode::merge);
+    return test_result();
+}
@@ -0,0 +1,300 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <SDL2/SDL.h>
+
+#include "chunks.cpp"
+
+// What colour a zoomed out pixel, a block of cells, gets
+enum class Reduce
+{
+    any, // live if any cell in the block is
+    density, // shaded by how many are
+};
+
+class ChunkRenderer
+{
+    /**
+     * @brief Draws the current generation of a ChunkLoader into a 32 bit (ARGB8888) SDL_Surface
+     * Only chunks overlapping the viewport are touched. At one cell per pixel each byte of a chunk row becomes 8 pixels
+     * copied from a lookup table. Zoomed out, 2^zoom x 2^zoom cells per pixel, the blocks are counted with popcount.
+     * There is no window here, so it also works with the dummy or offscreen video driver, SdlView puts it on screen.
+     */
+    SDL_Surface *frame = nullptr;
+    uint32_t live_colour, dead_colour;
+    uint32_t byte_pixels[256][8]; // the pixels of 8 cells, bit i is pixel i
+    uint32_t shades[257]; // dead to live, for Reduce::density
+    std::vector<uint32_t> counts; // live cells per pixel when zoomed out
+
+    // Calls fn(chunk_pos, chunk) for the non empty chunks overlapping the cells from (x0, y0) to (x1, y1).
+    // Looks the positions up while there are fewer of them than loaded chunks, otherwise goes through all chunks.
+    template<class Chunk, class Fn>
+    static void for_each_visible(ChunkLoader<Chunk> &life, const int64_t x0, const int64_t y0, const int64_t x1,
+        const int64_t y1, Fn fn)
+    {
+        static const int side = Chunk::side_len_b;
+        const int64_t first_x = x0 & ~(int64_t)(side - 1), first_y = y0 & ~(int64_t)(side - 1);
+        const int64_t columns = (x1 - first_x + side - 1) / side, rows = (y1 - first_y + side - 1) / side;
+        if(columns * rows <= (int64_t)life.chunk_count())
+        {
+            std::vector<Vect2i> positions(columns);
+            std::vector<const Chunk*> found(columns);
+            for(int64_t chunk_y = first_y; chunk_y < y1; chunk_y += side)
+            {
+                for(int64_t i = 0; i < columns; i++)
+                    positions[i] = {(int)(first_x + i * side), (int)chunk_y};
+                life.find_chunks(positions.data(), found.data(), columns);
+                for(int64_t i = 0; i < columns; i++)
+                {
+                    if(found[i] && found[i]->live_cells != 0)
+                        fn(positions[i], *found[i]);
+                }
+            }
+            return;
+        }
+        const int cur = life.current();
+        life.for_each_pair([&](const Vect2i &chunk_pos, ChunkPair<Chunk> &pair)
+        {
+            if(pair.gen[cur].live_cells != 0 && chunk_pos.x + side > x0 && chunk_pos.x < x1
+                && chunk_pos.y + side > y0 && chunk_pos.y < y1)
+                fn(chunk_pos, pair.gen[cur]);
+        });
+    }
+
+    inline uint32_t* row(const int y) const
+    {
+        return (uint32_t*)((char*)frame->pixels + (size_t)y * frame->pitch);
+    }
+
+    void clear_frame()
+    {
+        for(int y = 0; y < frame->h; y++)
+            std::fill(row(y), row(y) + frame->w, dead_colour);
+    }
+
+    // One cell per pixel, the frame is already cleared so only bytes with live cells are copied
+    template<class Chunk>
+    void draw_cells(ChunkLoader<Chunk> &life, const Vect2i &view_pos)
+    {
+        static const int side = Chunk::side_len_b;
+        const int64_t x0 = view_pos.x, y0 = view_pos.y, x1 = x0 + frame->w, y1 = y0 + frame->h;
+        for_each_visible(life, x0, y0, x1, y1, [&](const Vect2i &chunk_pos, const Chunk &chunk)
+        {
+            const int64_t from_x = std::max<int64_t>(x0, chunk_pos.x), to_x = std::min<int64_t>(x1, chunk_pos.x + side);
+            const int64_t from_y = std::max<int64_t>(y0, chunk_pos.y), to_y = std::min<int64_t>(y1, chunk_pos.y + side);
+            const int first = (from_x - chunk_pos.x) >> 3, last = (to_x - 1 - chunk_pos.x) >> 3;
+            for(int64_t y = from_y; y < to_y; y++)
+            {
+                const unsigned char *bytes = chunk.bytes + (y - chunk_pos.y) * Chunk::side_len;
+                uint32_t *pixels = row(y - y0);
+                for(int b = first; b <= last; b++)
+                {
+                    if(!bytes[b])
+                        continue;
+                    const int64_t byte_x = chunk_pos.x + b * 8;
+                    const int64_t lo = std::max(from_x, byte_x), hi = std::min(to_x, byte_x + 8);
+                    memcpy(pixels + (lo - x0), byte_pixels[bytes[b]] + (lo - byte_x), (hi - lo) * sizeof(uint32_t));
+                }
+            }
+        });
+    }
+
+    // 2^zoom cells per pixel, view_pos a multiple of that, so blocks never straddle a chunk edge
+    template<class Chunk>
+    void draw_blocks(ChunkLoader<Chunk> &life, const Vect2i &view_pos, const int zoom, const Reduce reduce)
+    {
+        typedef typename Chunk::Word Word;
+        static const int side = Chunk::side_len_b;
+        static const int word_bits = Chunk::word_bits;
+        const int width = frame->w, height = frame->h;
+        const int64_t block = (int64_t)1 << zoom;
+        const int64_t x0 = view_pos.x, y0 = view_pos.y, x1 = x0 + width * block, y1 = y0 + height * block;
+        counts.assign((size_t)width * height, 0);
+        for_each_visible(life, x0, y0, x1, y1, [&](const Vect2i &chunk_pos, const Chunk &chunk)
+        {
+            if(block >= side)
+            {
+                counts[((chunk_pos.y - y0) >> zoom) * width + ((chunk_pos.x - x0) >> zoom)] += chunk.live_cells;
+                return;
+            }
+            const int64_t from_y = std::max<int64_t>(y0, chunk_pos.y), to_y = std::min<int64_t>(y1, chunk_pos.y + side);
+            for(int64_t y = from_y; y < to_y; y++)
+            {
+                uint32_t *line = &counts[((y - y0) >> zoom) * width];
+                for(int w = 0; w < Chunk::row_words; w++)
+                {
+                    Word bits = chunk.get_word(y - chunk_pos.y, w);
+                    const int64_t word_x = chunk_pos.x + w * word_bits - x0;
+                    if(block >= word_bits)
+                    {
+                        const uint64_t px = word_x >> zoom;
+                        if(bits && px < (uint64_t)width)
+                            line[px] += __builtin_popcountll(bits);
+                        continue;
+                    }
+                    // blocks with nothing in them are skipped, good for sparse patterns
+                    while(bits)
+                    {
+                        const int start = __builtin_ctzll(bits) >> zoom << zoom;
+                        const Word group = (((Word)1 << block) - 1) << start;
+                        const uint64_t px = (word_x + start) >> zoom;
+                        if(px < (uint64_t)width)
+                            line[px] += __builtin_popcountll(bits & group);
+                        bits &= ~group;
+                    }
+                }
+            }
+        });
+        for(int y = 0; y < height; y++)
+        {
+            uint32_t *pixels = row(y);
+            const uint32_t *line = &counts[(size_t)y * width];
+            for(int x = 0; x < width; x++)
+            {
+                if(reduce == Reduce::any)
+                    pixels[x] = line[x] ? live_colour : dead_colour;
+                else // one live cell still shows
+                    pixels[x] = shades[line[x] ? std::max<uint64_t>(1, (uint64_t)line[x] * 256 >> (2 * zoom)) : 0];
+            }
+        }
+    }
+
+public:
+    static constexpr int max_zoom = 24;
+
+    // Colours are 0xAARRGGBB
+    ChunkRenderer(const int width, const int height, const uint32_t live = 0xffffffff, const uint32_t dead = 0xff000000)
+        : live_colour(live), dead_colour(dead)
+    {
+        for(int byte = 0; byte < 256; byte++)
+        {
+            for(int i = 0; i < 8; i++)
+                byte_pixels[byte][i] = get_bit(byte, i) ? live : dead;
+        }
+        for(int level = 0; level <= 256; level++)
+        {
+            uint32_t colour = 0;
+            for(int channel = 0; channel < 32; channel += 8)
+            {
+                const uint32_t from = dead >> channel & 0xff, to = live >> channel & 0xff;
+                colour |= (uint32_t)((int)from + ((int)to - (int)from) * level / 256) << channel;
+            }
+            shades[level] = colour;
+        }
+        resize(width, height);
+    }
+    ChunkRenderer(const ChunkRenderer&) = delete;
+    ChunkRenderer& operator=(const ChunkRenderer&) = delete;
+
+    // New frame size in pixels, the contents are lost. False if SDL could not make the surface
+    bool resize(const int width, const int height)
+    {
+        SDL_FreeSurface(frame);
+        frame = SDL_CreateRGBSurfaceWithFormat(0, std::max(1, width), std::max(1, height), 32, SDL_PIXELFORMAT_ARGB8888);
+        return frame != nullptr;
+    }
+
+    // Draws the cells from view_pos on, the top left pixel. Each pixel is 2^zoom x 2^zoom cells,
+    // for zoom > 0 view_pos is rounded down to a multiple of that
+    template<class Chunk>
+    void render(ChunkLoader<Chunk> &life, Vect2i view_pos, int zoom = 0, const Reduce reduce = Reduce::any)
+    {
+        if(!frame)
+            return;
+        zoom = std::min(std::max(zoom, 0), max_zoom);
+        if(SDL_MUSTLOCK(frame))
+            SDL_LockSurface(frame);
+        if(zoom == 0)
+        {
+            clear_frame();
+            draw_cells(life, view_pos);
+        }
+        else
+        {
+            view_pos = {view_pos.x & ~((1 << zoom) - 1), view_pos.y & ~((1 << zoom) - 1)};
+            draw_blocks(life, view_pos, zoom, reduce);
+        }
+        if(SDL_MUSTLOCK(frame))
+            SDL_UnlockSurface(frame);
+    }
+
+    SDL_Surface* surface() const
+    {
+        return frame;
+    }
+
+    ~ChunkRenderer()
+    {
+        SDL_FreeSurface(frame);
+    }
+};
+
+class SdlView
+{
+    /**
+     * @brief Window that shows ChunkRenderer frames, stretched to fill it, which is how zooming in works
+     * Under SDL_VIDEODRIVER=dummy or offscreen nothing reaches a screen but all of it still runs.
+     */
+    SDL_Window *window = nullptr;
+    SDL_Renderer *renderer = nullptr;
+    SDL_Texture *texture = nullptr;
+    int texture_w = 0, texture_h = 0;
+
+public:
+    // SDL_Init(SDL_INIT_VIDEO) has to be done first
+    SdlView(const char *title, const int width, const int height)
+    {
+        window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_RESIZABLE);
+        if(window)
+            renderer = SDL_CreateRenderer(window, -1, 0);
+        if(!renderer) // dummy drivers may have no accelerated renderer
+            renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE) : nullptr;
+    }
+    SdlView(const SdlView&) = delete;
+    SdlView& operator=(const SdlView&) = delete;
+
+    bool is_open() const
+    {
+        return renderer != nullptr;
+    }
+
+    void size(int &width, int &height) const
+    {
+        width = height = 0;
+        if(window)
+            SDL_GetWindowSize(window, &width, &height);
+    }
+
+    // Copies the frame into the streaming texture and presents it scaled to the window
+    void show(const ChunkRenderer &frame)
+    {
+        const SDL_Surface *surface = frame.surface();
+        if(!renderer || !surface)
+            return;
+        if(!texture || texture_w != surface->w || texture_h != surface->h)
+        {
+            SDL_DestroyTexture(texture);
+            texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, surface->w, surface->h);
+            texture_w = surface->w;
+            texture_h = surface->h;
+            if(!texture)
+                return;
+        }
+        SDL_UpdateTexture(texture, nullptr, surface->pixels, surface->pitch);
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+    }
+
+    ~SdlView()
+    {
+        if(texture)
+            SDL_DestroyTexture(texture);
+        if(renderer)
+            SDL_DestroyRenderer(renderer);
+        if(window)
+            SDL_DestroyWindow(window);
+    }
+};
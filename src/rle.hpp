@@ -0,0 +1,299 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "chunks.cpp"
+
+struct RleHeader
+{
+    /**
+     * @brief What the x = .., y = .., rule = .. line said
+     * Pos is from a #CXRLE line, the position of the top left cell.
+     */
+    int64_t width = 0, height = 0;
+    std::string rule = "B3/S23";
+    Vect2i pos;
+};
+
+class RleReader
+{
+    /**
+     * @brief Streaming RLE pattern parser
+     * Reads through a fixed buffer and ORs whole runs into the chunk rows, so memory does not grow with the file
+     * and there is one chunk lookup per run instead of a set() per cell.
+     */
+    static const int buffer_size = 1 << 16;
+
+    std::istream &in;
+    char buffer[buffer_size];
+    int buffer_pos = 0, buffer_len = 0;
+
+    // Last chunk written, runs mostly land in the same one
+    template<class Chunk>
+    struct Cursor
+    {
+        Chunk *chunk = nullptr;
+        Vect2i chunk_pos;
+    };
+
+    inline int next()
+    {
+        if(buffer_pos == buffer_len)
+        {
+            in.read(buffer, buffer_size);
+            buffer_len = in.gcount();
+            buffer_pos = 0;
+            if(buffer_len == 0)
+                return EOF;
+        }
+        return (unsigned char)buffer[buffer_pos++];
+    }
+
+    // Sets len cells from (x, y) to the right, a word of a chunk row at a time
+    template<class Chunk>
+    static void add_run(ChunkLoader<Chunk> &life, Cursor<Chunk> &cursor, int x, const int y, int64_t len)
+    {
+        typedef typename Chunk::Word Word;
+        static const int side = Chunk::side_len_b;
+        static const int word_bits = Chunk::word_bits;
+        while(len > 0)
+        {
+            const Vect2i pos = {x & ~(side - 1), y & ~(side - 1)};
+            if(!cursor.chunk || !(pos == cursor.chunk_pos))
+            {
+                cursor.chunk = life.load_chunk(pos);
+                cursor.chunk_pos = pos;
+            }
+            const int w = (x & (side - 1)) / word_bits;
+            const int local = x & (word_bits - 1);
+            const int take = std::min<int64_t>(len, word_bits - local);
+            const Word mask = (take == word_bits ? ~(Word)0 : ((Word)1 << take) - 1) << local;
+            const Word old_word = cursor.chunk->get_word(y & (side - 1), w);
+            cursor.chunk->set_word(y & (side - 1), w, old_word | mask);
+            cursor.chunk->live_cells += __builtin_popcountll(mask & ~old_word);
+            x += take;
+            len -= take;
+        }
+    }
+
+    void read_header(RleHeader &header)
+    {
+        std::string line;
+        while(in.peek() == '#' || isspace(in.peek()))
+        {
+            std::getline(in, line);
+            int x, y;
+            if(sscanf(line.c_str(), "#CXRLE Pos=%d,%d", &x, &y) == 2)
+                header.pos = {x, y};
+        }
+        if(in.peek() != 'x')
+            return; // no header, straight to the cells
+        std::getline(in, line);
+        long long width = 0, height = 0;
+        char rule[256] = "";
+        sscanf(line.c_str(), " x = %lld , y = %lld , rule = %255s", &width, &height, rule);
+        header.width = width;
+        header.height = height;
+        if(rule[0])
+            header.rule = rule;
+    }
+
+public:
+    RleReader(std::istream &in) : in(in)
+    {
+    }
+
+    // Adds the live cells of the pattern to life, with its top left cell at offset plus the #CXRLE position.
+    // Cells already in life are kept. Returns false on a malformed pattern, what was read so far stays in.
+    template<class Chunk>
+    bool read(ChunkLoader<Chunk> &life, const Vect2i &offset = Vect2i(), RleHeader *header_out = nullptr)
+    {
+        Cursor<Chunk> cursor;
+        RleHeader header;
+        read_header(header);
+        if(header_out)
+            *header_out = header;
+        const int left = offset.x + header.pos.x;
+        int x = left, y = offset.y + header.pos.y;
+        int64_t count = 0;
+        for(int c = next(); c != EOF; c = next())
+        {
+            if(c >= '0' && c <= '9')
+            {
+                count = count * 10 + (c - '0');
+                continue;
+            }
+            const int64_t n = count ? count : 1;
+            count = 0;
+            if(c == 'b' || c == '.')
+                x += n;
+            else if(c == '$')
+            {
+                x = left;
+                y += n;
+            }
+            else if(c == '!')
+                return true;
+            else if(isalpha(c)) // o, or any state of a multi-state pattern
+            {
+                add_run(life, cursor, x, y, n);
+                x += n;
+            }
+            else if(!isspace(c))
+                return false;
+        }
+        return false; // no closing !
+    }
+};
+
+class RleWriter
+{
+    /**
+     * @brief Streams the current generation of a ChunkLoader out as RLE
+     * Goes one band of chunks at a time, row by row, turning the packed rows straight into runs.
+     * Only a list of the live chunks is kept, never the cells.
+     */
+    static const int line_len = 70;
+
+    std::ostream &out;
+    std::string line;
+    int64_t live_run = 0; // not written yet, may carry on into the next chunk
+    int64_t run_end = 0; // x after the last live cell written in the row
+    int64_t row = 0, left = 0;
+
+    void put(int64_t count, const char tag)
+    {
+        if(count == 0)
+            return;
+        char token[24];
+        const int len = count == 1 ? snprintf(token, sizeof(token), "%c", tag) : snprintf(token, sizeof(token), "%lld%c", (long long)count, tag);
+        if((int)line.size() + len > line_len)
+        {
+            out << line << '\n';
+            line.clear();
+        }
+        line.append(token, len);
+    }
+
+    // Live cells from x to x + len in row y, must come in reading order
+    void live(const int64_t x, const int64_t y, const int64_t len)
+    {
+        if(y != row)
+        {
+            put(live_run, 'o');
+            live_run = 0;
+            put(y - row, '$'); // dead cells at the end of a row are left out
+            row = y;
+            run_end = left;
+        }
+        if(live_run && x == run_end)
+        {
+            live_run += len; // carries on across a chunk edge
+            run_end += len;
+            return;
+        }
+        put(live_run, 'o');
+        put(x - run_end, 'b');
+        live_run = len;
+        run_end = x + len;
+    }
+
+public:
+    RleWriter(std::ostream &out) : out(out)
+    {
+    }
+
+    // The rule line is the one life runs
+    template<class Chunk>
+    void write(ChunkLoader<Chunk> &life)
+    {
+        static const int side = Chunk::side_len_b;
+        static const int word_bits = Chunk::word_bits;
+        struct Live
+        {
+            Vect2i pos;
+            const Chunk *chunk;
+        };
+        std::vector<Live> chunks;
+        const int cur = life.current();
+        life.for_each_pair([&](const Vect2i &chunk_pos, ChunkPair<Chunk> &pair)
+        {
+            if(pair.gen[cur].live_cells != 0)
+                chunks.push_back({chunk_pos, &pair.gen[cur]});
+        });
+        std::sort(chunks.begin(), chunks.end(), [](const Live &a, const Live &b)
+        {
+            return a.pos.y < b.pos.y || (a.pos.y == b.pos.y && a.pos.x < b.pos.x);
+        });
+
+        // exact bounding box
+        int64_t min_x = INT64_MAX, max_x = INT64_MIN, min_y = INT64_MAX, max_y = INT64_MIN;
+        for(auto iter = chunks.begin(); iter != chunks.end(); ++iter)
+        {
+            for(int w = 0; w < Chunk::row_words; w++)
+            {
+                uint64_t columns = 0;
+                for(int y = 0; y < side; y++)
+                {
+                    const uint64_t bits = iter->chunk->get_word(y, w);
+                    if(!bits)
+                        continue;
+                    columns |= bits;
+                    min_y = std::min<int64_t>(min_y, iter->pos.y + y);
+                    max_y = std::max<int64_t>(max_y, iter->pos.y + y);
+                }
+                if(!columns)
+                    continue;
+                const int64_t word_x = iter->pos.x + w * word_bits;
+                min_x = std::min<int64_t>(min_x, word_x + __builtin_ctzll(columns));
+                max_x = std::max<int64_t>(max_x, word_x + 63 - __builtin_clzll(columns));
+            }
+        }
+        if(chunks.empty())
+            min_x = max_x = min_y = max_y = 0;
+        else
+            out << "#CXRLE Pos=" << min_x << ',' << min_y << '\n';
+        out << "x = " << (chunks.empty() ? 0 : max_x - min_x + 1) << ", y = " << (chunks.empty() ? 0 : max_y - min_y + 1)
+            << ", rule = " << life.rule().to_string() << '\n';
+
+        line.clear();
+        live_run = 0;
+        row = min_y;
+        left = run_end = min_x;
+        for(auto iter = chunks.begin(); iter != chunks.end(); )
+        {
+            auto band_end = iter;
+            while(band_end != chunks.end() && band_end->pos.y == iter->pos.y)
+                ++band_end;
+            for(int y = 0; y < side; y++)
+            {
+                for(auto chunk = iter; chunk != band_end; ++chunk)
+                {
+                    for(int w = 0; w < Chunk::row_words; w++)
+                    {
+                        uint64_t rest = chunk->chunk->get_word(y, w);
+                        while(rest)
+                        {
+                            const int start = __builtin_ctzll(rest);
+                            const uint64_t run = ~(rest >> start);
+                            const int len = run ? __builtin_ctzll(run) : 64 - start;
+                            rest = start + len < 64 ? rest & (~(uint64_t)0 << (start + len)) : 0;
+                            live(chunk->pos.x + w * word_bits + start, chunk->pos.y + y, len);
+                        }
+                    }
+                }
+            }
+            iter = band_end;
+        }
+        put(live_run, 'o');
+        line += '!';
+        out << line << '\n';
+    }
+};
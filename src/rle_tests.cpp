@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <sstream>
+#include <string>
+
+#include "rle.hpp"
+#include "test_cells.hpp"
+
+// RleWriter output read back by RleReader gives the same cells at the same place, and hand written patterns
+// parse the way the format says
+
+std::string write(const Cells &cells)
+{
+    BoolChunkLoader life;
+    set_cells(life, cells);
+    std::ostringstream out;
+    RleWriter(out).write(life);
+    return out.str();
+}
+
+bool read(const std::string &text, Cells &cells, const Vect2i &offset = Vect2i(), RleHeader *header = nullptr)
+{
+    BoolChunkLoader life;
+    std::istringstream in(text);
+    const bool ok = RleReader(in).read(life, offset, header);
+    cells = cells_of(life);
+    return ok;
+}
+
+void check_round_trip(const Cells &cells, const std::string &what)
+{
+    const std::string text = write(cells);
+    Cells back;
+    RleHeader header;
+    bool ok = read(text, back, Vect2i(), &header) && back == cells;
+    // exact box, and no line past 70 columns
+    if(!cells.empty())
+    {
+        int min_x = INT32_MAX, max_x = INT32_MIN, min_y = INT32_MAX, max_y = INT32_MIN;
+        for(const auto &cell : cells)
+        {
+            min_x = std::min(min_x, cell.first);
+            max_x = std::max(max_x, cell.first);
+            min_y = std::min(min_y, cell.second);
+            max_y = std::max(max_y, cell.second);
+        }
+        ok = ok && header.pos == Vect2i(min_x, min_y) && header.width == max_x - min_x + 1
+            && header.height == max_y - min_y + 1;
+    }
+    std::istringstream lines(text);
+    for(std::string line; std::getline(lines, line); )
+        ok = ok && line.size() <= 70;
+    check(ok, "round trip, " + what);
+}
+
+int main()
+{
+    check_round_trip(Cells(), "nothing");
+    check_round_trip({{-1, -1}}, "one cell");
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for(const int percent : {5, 50, 95})
+    {
+        // across chunk edges and the origin, dense enough for runs over chunk edges
+        check_round_trip(soup({-70, -45}, 150, percent, seed), "soup " + std::to_string(percent) + "%");
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    Cells lines;
+    for(int y = 0; y < 200; y += 7)
+    {
+        for(int x = -100 + y; x < 100 + 2 * y; x++)
+            lines.insert({x, y});
+    }
+    check_round_trip(lines, "runs over many chunks");
+    Cells far;
+    for(const auto &cell : soup({0, 0}, 20, 50, seed))
+        far.insert({cell.first + 3000000, cell.second - 5000000});
+    check_round_trip(far, "far from the origin");
+
+    const Cells glider = {{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}};
+    Cells cells;
+    RleHeader header;
+    check(read("#N Glider\n#C a comment\nx = 3, y = 3, rule = B3/S23\nbo$2bo$3o!\n", cells, Vect2i(), &header)
+        && cells == glider && header.width == 3 && header.height == 3 && header.rule == "B3/S23", "glider");
+    Cells moved;
+    for(const auto &cell : glider)
+        moved.insert({cell.first - 7, cell.second + 40});
+    {
+        // the rule line is the loader's
+        BoolChunkLoader life;
+        life.set_rule(LifeRule(1 << 3 | 1 << 6, 1 << 2 | 1 << 3));
+        set_cells(life, glider);
+        std::ostringstream out;
+        RleWriter(out).write(life);
+        check(read(out.str(), cells, Vect2i(), &header) && cells == glider && header.rule == "B36/S23", "rule line");
+    }
+    check(read("#CXRLE Pos=-10,30\nx = 3, y = 3\nbo$2b\no$3o!", cells, {3, 10}) && cells == moved, "position and offset");
+    check(read("bo$2bo$3o!", cells) && cells == glider, "no header");
+    Cells block = {{0, 0}, {1, 0}, {0, 3}, {1, 3}};
+    check(read("x = 2, y = 4\n2o3$2A!", cells) && cells == block, "blank rows and other states");
+    check(!read("x = 3, y = 3\nbo$2bo$3o", cells), "no closing !");
+    check(!read("x = 3, y = 3\nbo$2b?o$3o!", cells), "stray character");
+    return test_result();
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+struct LifeRule
+{
+    /**
+     * @brief Outer totalistic rule, Life-like in B/S notation
+     * Bit n of birth (survive) is set if a dead (live) cell with n live neighbours is alive next generation.
+     * B0 rules are refused, they would fill the endless empty space around the chunks in one tick.
+     */
+    uint16_t birth = 1 << 3;
+    uint16_t survive = 1 << 2 | 1 << 3;
+
+    constexpr LifeRule()
+    {
+    }
+
+    constexpr LifeRule(const uint16_t birth, const uint16_t survive) : birth(birth), survive(survive)
+    {
+    }
+
+    // Both masks in one number, birth in the low 9 bits, survive above, usable as a template argument
+    constexpr uint32_t code() const
+    {
+        return birth | (uint32_t)survive << 9;
+    }
+
+    static constexpr LifeRule from_code(const uint32_t code)
+    {
+        return LifeRule(code & 0x1ff, code >> 9 & 0x1ff);
+    }
+
+    // 0 or 1 for a cell, from the table and not a branch
+    constexpr int next(const bool alive, const int neighbours) const
+    {
+        return code() >> (neighbours + 9 * alive) & 1;
+    }
+
+    constexpr bool operator==(const LifeRule &other) const
+    {
+        return code() == other.code();
+    }
+
+    // B3/S23, S23/B3 or the old 23/3 (survive/birth), any case. False if text is none of those or has B0
+    static constexpr bool parse(const char *text, LifeRule &rule)
+    {
+        uint16_t masks[2] = {0, 0}; // birth, survive
+        int part = -1; // which mask the digits go to
+        bool seen[2] = {false, false};
+        const bool old_style = (text[0] >= '0' && text[0] <= '9') || text[0] == '/';
+        if(old_style)
+        {
+            part = 1;
+            seen[1] = true;
+        }
+        for(const char *c = text; *c; c++)
+        {
+            if(*c == 'B' || *c == 'b' || *c == 'S' || *c == 's')
+            {
+                if(old_style)
+                    return false;
+                part = *c == 'B' || *c == 'b' ? 0 : 1;
+                if(seen[part])
+                    return false;
+                seen[part] = true;
+            }
+            else if(*c == '/')
+            {
+                if(old_style)
+                {
+                    if(part == 0)
+                        return false;
+                    part = 0;
+                    seen[0] = true;
+                }
+            }
+            else if(*c >= '0' && *c <= '8' && part >= 0)
+                masks[part] |= 1 << (*c - '0');
+            else
+                return false;
+        }
+        if(!seen[0] || !seen[1] || (masks[0] & 1))
+            return false;
+        rule = LifeRule(masks[0], masks[1]);
+        return true;
+    }
+
+    // code() of a rule string, for baking rules in at compile time. ~0 if it does not parse
+    static constexpr uint32_t code_of(const char *text)
+    {
+        LifeRule rule;
+        return parse(text, rule) ? rule.code() : ~(uint32_t)0;
+    }
+
+    std::string to_string() const
+    {
+        std::string text = "B";
+        for(int n = 0; n <= 8; n++)
+        {
+            if(birth >> n & 1)
+                text += '0' + n;
+        }
+        text += "/S";
+        for(int n = 0; n <= 8; n++)
+        {
+            if(survive >> n & 1)
+                text += '0' + n;
+        }
+        return text;
+    }
+};
@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <string>
+
+#include "rule.hpp"
+#include "tests.hpp"
+
+// LifeRule reads every notation it takes, turns down what it does not, and its code and text go back to the same rule
+
+bool parses_to(const char *text, const LifeRule &expected)
+{
+    LifeRule rule(0, 0);
+    return LifeRule::parse(text, rule) && rule == expected;
+}
+
+bool refused(const char *text)
+{
+    LifeRule rule(1 << 1, 1 << 1);
+    return !LifeRule::parse(text, rule) && rule == LifeRule(1 << 1, 1 << 1);
+}
+
+int main()
+{
+    const LifeRule life;
+    const LifeRule highlife(1 << 3 | 1 << 6, 1 << 2 | 1 << 3);
+    check(parses_to("B3/S23", life) && parses_to("b3/s23", life) && parses_to("S23/B3", life) && parses_to("23/3", life),
+        "Life in every notation");
+    check(parses_to("B36/S23", highlife) && parses_to("23/36", highlife), "HighLife");
+    check(parses_to("B3/S", LifeRule(1 << 3, 0)) && parses_to("/3", LifeRule(1 << 3, 0)), "nothing survives");
+    check(parses_to("B3/S012345678", LifeRule(1 << 3, 0x1ff)), "everything survives");
+    check(refused("B03/S23") && refused("b0/s") && refused("23/03"), "B0 refused");
+    check(refused("") && refused("B3") && refused("S23") && refused("B3/S29") && refused("B3/B3") && refused("B3/S23x")
+        && refused("23/3/1") && refused("3/S23"), "not a rule");
+
+    // every rule without B0, there are only 2^17 of them
+    bool ok = true;
+    for(uint32_t code = 0; ok && code < 1 << 18; code += 2)
+    {
+        const LifeRule rule = LifeRule::from_code(code);
+        LifeRule back(0, 0);
+        ok = rule.code() == code && LifeRule::parse(rule.to_string().c_str(), back) && back == rule;
+        for(int neighbours = 0; ok && neighbours <= 8; neighbours++)
+        {
+            ok = rule.next(false, neighbours) == (rule.birth >> neighbours & 1)
+                && rule.next(true, neighbours) == (rule.survive >> neighbours & 1);
+        }
+    }
+    check(ok, "code, to_string and next agree for every rule");
+    check(LifeRule::code_of("B36/S23") == highlife.code() && LifeRule::code_of("B0/S23") == ~(uint32_t)0, "code_of");
+    return test_result();
+}
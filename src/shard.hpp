@@ -0,0 +1,471 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "simulation.cpp"
+
+// Which worker owns a chunk. The plane is cut into stripes stripe_chunks chunks wide, running up and down forever,
+// and the stripes are dealt out to the shards in turn, so shard i only ever borders shards i - 1 and i + 1.
+template<class Chunk>
+struct ShardLayout
+{
+    int shards;
+    int stripe_chunks;
+
+    inline int64_t stripe(const int chunk_x) const
+    {
+        const int64_t column = chunk_x >> Chunk::side_shift;
+        return (column >= 0 ? column : column - stripe_chunks + 1) / stripe_chunks;
+    }
+
+    inline int owner_of_stripe(const int64_t stripe) const
+    {
+        return (int)((stripe % shards + shards) % shards);
+    }
+
+    inline int owner(const int chunk_x) const
+    {
+        return owner_of_stripe(stripe(chunk_x));
+    }
+
+    // Chunk is the first or last column of its stripe
+    inline bool west_edge(const int chunk_x) const
+    {
+        return stripe(chunk_x) != stripe(chunk_x - Chunk::side_len_b);
+    }
+    inline bool east_edge(const int chunk_x) const
+    {
+        return stripe(chunk_x) != stripe(chunk_x + Chunk::side_len_b);
+    }
+};
+
+// What goes over the sockets. Every message is a ShardMessage and size bytes after it, all in the byte order of
+// the machine, the workers are always local.
+enum class ShardOp : uint32_t
+{
+    cells, // ShardRecords to merge in, both ways
+    step, // coordinator: do arg generations. Worker answers halo, gets cells, ticks and answers done
+    halo, // worker: ShardRecords of its edge cells, to of each says for which shard
+    done, // worker: a ShardStats
+    collect, // coordinator: send all your cells back as cells
+    quit,
+};
+
+struct ShardMessage
+{
+    ShardOp op;
+    int32_t arg;
+    uint64_t size;
+};
+
+// A width x height packed bitmap at (x, y), as read_region() writes it, the words follow
+struct ShardRecord
+{
+    int32_t to;
+    int32_t x, y;
+    int32_t width, height;
+};
+
+struct ShardStats
+{
+    int64_t population;
+    int64_t live_chunks;
+    int64_t chunks;
+};
+
+inline bool shard_send(const int fd, const ShardOp op, const int32_t arg, const void *data, const size_t size)
+{
+    const ShardMessage message = {op, arg, size};
+    const char *parts[2] = {(const char*)&message, (const char*)data};
+    size_t lens[2] = {sizeof(message), size};
+    for(int i = 0; i < 2; i++)
+    {
+        while(lens[i] > 0)
+        {
+            const ssize_t done = send(fd, parts[i], lens[i], MSG_NOSIGNAL); // a dead peer is an error, not SIGPIPE
+            if(done < 0 && errno == EINTR)
+                continue;
+            if(done <= 0)
+                return false;
+            parts[i] += done;
+            lens[i] -= done;
+        }
+    }
+    return true;
+}
+
+inline bool shard_read_all(const int fd, void *data, size_t size)
+{
+    char *at = (char*)data;
+    while(size > 0)
+    {
+        const ssize_t done = read(fd, at, size);
+        if(done < 0 && errno == EINTR)
+            continue;
+        if(done <= 0)
+            return false;
+        at += done;
+        size -= done;
+    }
+    return true;
+}
+
+// Next message into message and payload, false if the peer is gone or sent op other than expected
+inline bool shard_receive(const int fd, const ShardOp expected, ShardMessage &message, std::vector<char> &payload)
+{
+    if(!shard_read_all(fd, &message, sizeof(message)) || message.op != expected)
+        return false;
+    payload.resize(message.size);
+    return shard_read_all(fd, payload.data(), payload.size());
+}
+
+// Appends a record of the width x height cells of life at pos, nothing if they are all dead
+template<class Chunk>
+void add_shard_record(const ChunkLoader<Chunk> &life, const int to, const Vect2i &pos, const int width, const int height,
+    std::vector<uint64_t> &rows, std::vector<char> &out)
+{
+    const size_t stride = (width + 63) / 64;
+    rows.resize(stride * height);
+    life.read_region(pos, width, height, rows.data(), stride);
+    if(std::all_of(rows.begin(), rows.end(), [](const uint64_t word) { return word == 0; }))
+        return;
+    const ShardRecord record = {to, pos.x, pos.y, width, height};
+    out.insert(out.end(), (const char*)&record, (const char*)(&record + 1));
+    out.insert(out.end(), (const char*)rows.data(), (const char*)(rows.data() + rows.size()));
+}
+
+// Calls fn(record, words) for every record of a cells or halo payload, false if it is cut short
+template<class Fn>
+bool for_each_shard_record(const std::vector<char> &payload, Fn fn)
+{
+    std::vector<uint64_t> rows;
+    for(size_t at = 0; at < payload.size(); )
+    {
+        ShardRecord record;
+        if(payload.size() - at < sizeof(record))
+            return false;
+        memcpy(&record, &payload[at], sizeof(record));
+        at += sizeof(record);
+        const size_t bytes = (size_t)(record.width + 63) / 64 * record.height * sizeof(uint64_t);
+        if(record.width <= 0 || record.height <= 0 || payload.size() - at < bytes)
+            return false;
+        rows.resize(bytes / sizeof(uint64_t));
+        memcpy(rows.data(), &payload[at], bytes);
+        at += bytes;
+        fn(record, rows.data(), bytes);
+    }
+    return true;
+}
+
+template<class Chunk>
+bool merge_shard_records(ChunkLoader<Chunk> &life, const std::vector<char> &payload)
+{
+    return for_each_shard_record(payload, [&](const ShardRecord &record, const uint64_t *rows, size_t)
+    {
+        life.write_region({record.x, record.y}, record.width, record.height, rows, (record.width + 63) / 64, BlitMode::merge);
+    });
+}
+
+template<class Chunk>
+class ShardWorker
+{
+    /**
+     * @brief One shard of a sharded run, in a process of its own, owning the chunks of its stripes
+     * A round: the cells of its stripe edges, as deep as the round is generations, go out to the coordinator,
+     * the same from the neighbours come back and are written in next to the edges, the loader ticks, and
+     * everything outside the stripes is cleared again. The owned chunks then hold exactly what one big loader would.
+     * Cells crossing into a neighbour's stripe are born there from the halo it got, so patterns move between shards
+     * without anything being handed over.
+     */
+    int fd;
+    int shard;
+    ShardLayout<Chunk> layout;
+    BasicBoolChunkLoader<Chunk> life;
+    std::vector<char> out, payload;
+    std::vector<uint64_t> rows;
+    std::vector<Vect2i> foreign;
+
+    // Strips generations cells deep along the outside edges of the owned stripes, for the shards on the other side
+    void send_halo(const int generations)
+    {
+        static const int side = Chunk::side_len_b;
+        out.clear();
+        for(const auto entry : life.loaded_chunks())
+        {
+            const Vect2i &pos = entry.pos;
+            if(entry.chunk.live_cells == 0 || layout.owner(pos.x) != shard)
+                continue;
+            if(layout.west_edge(pos.x) && layout.owner(pos.x - side) != shard)
+                add_shard_record(life, layout.owner(pos.x - side), pos, generations, side, rows, out);
+            if(layout.east_edge(pos.x) && layout.owner(pos.x + side) != shard)
+                add_shard_record(life, layout.owner(pos.x + side), {pos.x + side - generations, pos.y}, generations, side, rows, out);
+        }
+    }
+
+    bool step(int generations)
+    {
+        generations = std::min(std::max(generations, 1), ChunkRegion<Chunk>::pad);
+        send_halo(generations);
+        ShardMessage message;
+        if(!shard_send(fd, ShardOp::halo, 0, out.data(), out.size()) || !shard_receive(fd, ShardOp::cells, message, payload)
+            || !merge_shard_records(life, payload))
+            return false;
+        tick_bitwise(life, generations);
+        // what the halo and the cells next to it turned into is the neighbour's business
+        foreign.clear();
+        for(const auto entry : life.loaded_chunks())
+        {
+            if(entry.chunk.live_cells != 0 && layout.owner(entry.pos.x) != shard)
+                foreign.push_back(entry.pos);
+        }
+        for(const Vect2i &pos : foreign)
+            life.clear_chunk(pos);
+        life.cull();
+        const ShardStats stats = {life.population(), life.live_chunk_count(), (int64_t)life.chunk_count()};
+        return shard_send(fd, ShardOp::done, generations, &stats, sizeof(stats));
+    }
+
+    bool collect()
+    {
+        static const int side = Chunk::side_len_b;
+        out.clear();
+        for(const auto entry : life.loaded_chunks())
+        {
+            if(entry.chunk.live_cells != 0)
+                add_shard_record(life, shard, entry.pos, side, side, rows, out);
+        }
+        return shard_send(fd, ShardOp::cells, 0, out.data(), out.size());
+    }
+
+public:
+    ShardWorker(const int fd, const int shard, const ShardLayout<Chunk> &layout, const LifeRule &rule)
+        : fd(fd), shard(shard), layout(layout)
+    {
+        life.set_rule(rule);
+    }
+
+    // Serves the coordinator until it says quit, false if it went away first
+    bool run()
+    {
+        ShardMessage message;
+        while(shard_read_all(fd, &message, sizeof(message)))
+        {
+            bool ok = true;
+            switch (message.op)
+            {
+            case ShardOp::cells:
+                payload.resize(message.size);
+                ok = shard_read_all(fd, payload.data(), payload.size()) && merge_shard_records(life, payload);
+                break;
+            case ShardOp::step:
+                ok = step(message.arg);
+                break;
+            case ShardOp::collect:
+                ok = collect();
+                break;
+            case ShardOp::quit:
+                return true;
+            default:
+                ok = false;
+            }
+            if(!ok)
+                return false;
+        }
+        return false;
+    }
+};
+
+template<class Chunk>
+class ShardCoordinator
+{
+    /**
+     * @brief Runs a universe split over several local worker processes, see ShardWorker
+     * Each worker is forked with a socketpair to the coordinator. The halos go through the coordinator too,
+     * it reads every worker's then writes every worker theirs, so no two workers ever wait on each other
+     * and a full socket buffer can not deadlock. Halos are small next to the chunks, which stay in the workers.
+     */
+    ShardLayout<Chunk> layout;
+    std::vector<int> fds;
+    std::vector<pid_t> pids;
+    std::vector<std::vector<char>> inbox;
+    std::vector<char> payload;
+    ShardStats totals = {};
+
+public:
+    // Forks shards workers, stripes stripe_chunks chunks wide. Check ok() after
+    ShardCoordinator(const int shards, const int stripe_chunks = 8, const LifeRule &rule = LifeRule())
+    {
+        layout.shards = std::max(1, shards);
+        layout.stripe_chunks = std::max(1, stripe_chunks);
+        for(int i = 0; i < layout.shards; i++)
+        {
+            int pair[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+                break;
+            fflush(stdout); // or the child writes out the parent's buffer too
+            const pid_t pid = fork();
+            if(pid < 0)
+            {
+                close(pair[0]);
+                close(pair[1]);
+                break;
+            }
+            if(pid == 0)
+            {
+                close(pair[0]);
+                for(const int fd : fds)
+                    close(fd);
+                ShardWorker<Chunk> *worker = new ShardWorker<Chunk>(pair[1], i, layout, rule);
+                const bool clean = worker->run();
+                delete worker;
+                _exit(clean ? 0 : 1);
+            }
+            close(pair[1]);
+            fds.push_back(pair[0]);
+            pids.push_back(pid);
+        }
+        inbox.resize(fds.size());
+    }
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+    // False if not every worker could be started
+    bool ok() const
+    {
+        return (int)fds.size() == layout.shards;
+    }
+
+    int shards() const
+    {
+        return layout.shards;
+    }
+
+    // Hands the live chunks of life to their owners, merged with what they have
+    bool scatter(const ChunkLoader<Chunk> &life)
+    {
+        static const int side = Chunk::side_len_b;
+        std::vector<uint64_t> rows;
+        for(auto &cells : inbox)
+            cells.clear();
+        for(const auto entry : life.loaded_chunks())
+        {
+            if(entry.chunk.live_cells != 0)
+            {
+                const int to = layout.owner(entry.pos.x);
+                add_shard_record(life, to, entry.pos, side, side, rows, inbox[to]);
+            }
+        }
+        for(size_t i = 0; i < fds.size(); i++)
+        {
+            if(!shard_send(fds[i], ShardOp::cells, 0, inbox[i].data(), inbox[i].size()))
+                return false;
+        }
+        return true;
+    }
+
+    // One round of generations generations (at most ChunkRegion::pad), returns how many, 0 if a worker failed
+    int step(const int generations)
+    {
+        for(const int fd : fds)
+        {
+            if(!shard_send(fd, ShardOp::step, generations, nullptr, 0))
+                return 0;
+        }
+        for(auto &cells : inbox)
+            cells.clear();
+        ShardMessage message;
+        for(const int fd : fds)
+        {
+            if(!shard_receive(fd, ShardOp::halo, message, payload))
+                return 0;
+            const bool whole = for_each_shard_record(payload, [&](const ShardRecord &record, const uint64_t *rows, size_t bytes)
+            {
+                std::vector<char> &cells = inbox[std::min(std::max(record.to, 0), layout.shards - 1)];
+                cells.insert(cells.end(), (const char*)&record, (const char*)(&record + 1));
+                cells.insert(cells.end(), (const char*)rows, (const char*)rows + bytes);
+            });
+            if(!whole)
+                return 0;
+        }
+        for(size_t i = 0; i < fds.size(); i++)
+        {
+            if(!shard_send(fds[i], ShardOp::cells, 0, inbox[i].data(), inbox[i].size()))
+                return 0;
+        }
+        totals = {};
+        int done = 0;
+        for(const int fd : fds)
+        {
+            ShardStats stats;
+            if(!shard_receive(fd, ShardOp::done, message, payload) || payload.size() != sizeof(stats))
+                return 0;
+            memcpy(&stats, payload.data(), sizeof(stats));
+            totals.population += stats.population;
+            totals.live_chunks += stats.live_chunks;
+            totals.chunks += stats.chunks;
+            done = message.arg;
+        }
+        return done;
+    }
+
+    // Merges the cells of every worker into life
+    bool gather(ChunkLoader<Chunk> &life)
+    {
+        ShardMessage message;
+        for(const int fd : fds)
+        {
+            if(!shard_send(fd, ShardOp::collect, 0, nullptr, 0) || !shard_receive(fd, ShardOp::cells, message, payload)
+                || !merge_shard_records(life, payload))
+                return false;
+        }
+        return true;
+    }
+
+    // Summed over the workers as of the last step()
+    const ShardStats& stats() const
+    {
+        return totals;
+    }
+
+    ~ShardCoordinator()
+    {
+        for(const int fd : fds)
+        {
+            shard_send(fd, ShardOp::quit, 0, nullptr, 0);
+            close(fd);
+        }
+        for(const pid_t pid : pids)
+            waitpid(pid, nullptr, 0);
+    }
+};
+
+// run_simulation() over shards worker processes, without graphics. The cells of life are handed out, stepped
+// block generations a round, and gathered back into life at the end. Null if a worker failed.
+template<class Chunk>
+BasicBoolChunkLoader<Chunk>* run_sharded(BasicBoolChunkLoader<Chunk> *life, const int shards, const int simulation_len,
+    const int block = 1, const int stripe_chunks = 8, const bool progress = true, const uint64_t first_generation = 0)
+{
+    ShardCoordinator<Chunk> coordinator(shards, stripe_chunks, life->rule());
+    if(!coordinator.ok() || !coordinator.scatter(*life))
+        return nullptr;
+    life->clear(); // the workers have it now
+    for(int i = 0, done = 0; i < simulation_len; i += done)
+    {
+        done = coordinator.step(std::min(block, simulation_len - i));
+        if(done == 0)
+            return nullptr;
+        if(progress && (first_generation + i) % 100 + done >= 100)
+            std::cout << "Generation, population, chunks: " << first_generation + i + done << ", "
+                << coordinator.stats().population << ", " << coordinator.stats().chunks << '\n';
+    }
+    if(!coordinator.gather(*life))
+        return nullptr;
+    return life;
+}
@@ -0,0 +1,681 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+#include "chunks.cpp"
+#include "kernel.hpp"
+#include "thread_pool.hpp"
+#include "hashlife.hpp"
+#include "rle.hpp"
+#include "snapshot.hpp"
+#include "terminal.hpp"
+#include "dense.hpp"
+
+// Grid is the concrete type, so get()/set() through the offset are resolved statically
+template<class Grid>
+class Offset2D final : public Decorator<BoolGrid2D, Grid>
+{
+    Vect2i offset;
+public:
+    Offset2D(Grid *decorated, Vect2i offset) 
+    {
+        this->decorated = decorated;
+        this->offset = offset;
+    }
+    inline bool get(const Vect2i &pos) const override
+    {
+        return this->decorated->get(pos+offset);
+    }
+    inline void set(const Vect2i &pos, bool val) override
+    {
+        this->decorated->set(pos+offset, val);
+    }
+};
+
+void print_board_compact(const BoolGrid2D&, int);
+
+template<class Grid>
+inline int sum_neighbours(const Grid &c, const int x, const int y)
+{
+    int sum = 0;
+    for(int i = x-1; i<=x+1; i++)
+    {
+        for(int j = y-1; j<=y+1; j++)
+        {
+            sum += c.get({i, j}); 
+        }
+    }
+    sum -= c.get({x, y});
+    return sum;
+}
+
+template<class Grid>
+inline int sum_triect(const Grid &c, const int x, const int y)
+{
+    return c.get({x, y - 1}) + c.get({x, y}) + c.get({x, y + 1});
+}
+
+template<class Chunk>
+using ChunkHaloFor = BasicChunkHalo<typename Chunk::Word, Chunk::side_len_b>;
+
+// Fills the kernel input for word column w from the 3x3 chunks around, indexed (dx + 1) * 3 + dy + 1, null ones are empty
+template<class Chunk>
+void fill_halo(const Chunk *const *found, const int w, ChunkHaloFor<Chunk> &halo)
+{
+    typedef typename Chunk::Word Word;
+    static const int side = Chunk::side_len_b;
+    Word *columns[3] = {halo.west, halo.centre, halo.east};
+    for(int dx = -1; dx <= 1; dx++)
+    {
+        // the words left and right of w, in the chunks next door at the edges
+        int word = w + dx, chunk_dx = 0;
+        if(word < 0)
+        {
+            word = Chunk::row_words - 1;
+            chunk_dx = -1;
+        }
+        else if(word == Chunk::row_words)
+        {
+            word = 0;
+            chunk_dx = 1;
+        }
+        Word *column = columns[dx + 1];
+        const Chunk *up = found[(chunk_dx + 1) * 3];
+        const Chunk *mid = found[(chunk_dx + 1) * 3 + 1];
+        const Chunk *down = found[(chunk_dx + 1) * 3 + 2];
+        column[0] = up ? up->get_word(side - 1, word) : 0;
+        for(int y = 0; y < side; y++)
+            column[y + 1] = mid ? mid->get_word(y, word) : 0;
+        column[side + 1] = down ? down->get_word(0, word) : 0;
+    }
+}
+
+// Current generation of the 3x3 chunks around a loaded chunk, through its neighbour pointers
+template<class Chunk>
+void find_neighbours(const ChunkPair<Chunk> &pair, const int cur, const Chunk **found)
+{
+    for(int i = 0; i < 9; i++)
+        found[i] = pair.neighbours[i] ? &pair.neighbours[i]->gen[cur] : nullptr;
+}
+
+// Same for a chunk that is not loaded, the neighbours are looked up in the map
+template<class Chunk>
+void find_neighbours(const ChunkLoader<Chunk> &from, const Vect2i &chunk_pos, const Chunk **found)
+{
+    static const int side = Chunk::side_len_b;
+    Vect2i positions[9];
+    for(int i = 0; i < 9; i++)
+        positions[i] = {chunk_pos.x + (i / 3 - 1) * side, chunk_pos.y + (i % 3 - 1) * side};
+    from.find_chunks(positions, found, 9);
+}
+
+// Next generation of the middle chunk of found into result (laid out as set_rows() wants), returns its live cells.
+// Wide chunks go through the kernel one word column at a time.
+template<class Chunk>
+int step_chunk(const Chunk *const *found, const BasicLifeStepFn<ChunkHaloFor<Chunk>> life_step, const LifeRule &rule,
+    ChunkHaloFor<Chunk> &halo, typename Chunk::Word *result)
+{
+    static const int side = Chunk::side_len_b;
+    if(Chunk::row_words == 1)
+    {
+        {
+            PROFILE_SCOPE(halo);
+            fill_halo(found, 0, halo);
+        }
+        PROFILE_SCOPE(compute);
+        return life_step(halo, result, rule);
+    }
+    typename Chunk::Word column[side];
+    int live_cells = 0;
+    for(int w = 0; w < Chunk::row_words; w++)
+    {
+        {
+            PROFILE_SCOPE(halo);
+            fill_halo(found, w, halo);
+        }
+        PROFILE_SCOPE(compute);
+        live_cells += life_step(halo, column, rule);
+        for(int y = 0; y < side; y++)
+            result[y * Chunk::row_words + w] = column[y];
+    }
+    return live_cells;
+}
+
+// A chunk for stepping several generations at once (temporal blocking): its rows with pad cells on each side, in
+// words of 64 cells stored by column for life_step_column_v(), and a row above and bellow for every generation.
+// pad is the most generations at once, 16 for 32 cell chunks and 32 for the others.
+template<class Chunk>
+struct ChunkRegion
+{
+    static constexpr int side = Chunk::side_len_b;
+    static constexpr int words = side / 64 + 1;
+    static constexpr int pad = (words * 64 - side) / 2; // constexpr, std::min takes it by reference
+    static_assert(side + 2 * pad <= column_rows, "Chunk too big for the column kernel");
+    uint64_t columns[2][words][column_padded_rows]; // this generation and the next
+};
+
+// Fills region columns with the cells within generations rows and pad columns of the middle chunk of found
+template<class Chunk>
+void fill_region(const Chunk *const *found, const int generations, uint64_t (*columns)[column_padded_rows])
+{
+    typedef ChunkRegion<Chunk> Region;
+    static const int side = Chunk::side_len_b;
+    static const int word_bits = Chunk::word_bits;
+    static const int width = Region::words * 64;
+    for(int r = 0; r < side + 2 * generations; r++)
+    {
+        const int y = r - generations;
+        const int dy = y < 0 ? -1 : (y >= side ? 1 : 0);
+        // len is clipped to width, so deposit_bits never spills past the last word, the spare one is for the compiler
+        uint64_t row[Region::words + 1] = {};
+        for(int dx = -1; dx <= 1; dx++)
+        {
+            const Chunk *chunk = found[(dx + 1) * 3 + dy + 1];
+            if(!chunk)
+                continue;
+            for(int w = 0; w < Chunk::row_words; w++)
+            {
+                int at = Region::pad + dx * side + w * word_bits; // where the first cell of the word goes
+                if(at + word_bits <= 0 || at >= width)
+                    continue;
+                uint64_t bits = chunk->get_word(y - dy * side, w);
+                int len = word_bits;
+                if(at < 0)
+                {
+                    bits >>= -at;
+                    len += at;
+                    at = 0;
+                }
+                len = std::min(len, width - at);
+                if(len < 64)
+                    bits &= ((uint64_t)1 << len) - 1;
+                if(bits)
+                    deposit_bits(row, at, bits, len);
+            }
+        }
+        for(int c = 0; c < Region::words; c++)
+            columns[c][r] = row[c];
+    }
+}
+
+// generations generations of the middle chunk of found at once into result (laid out as set_rows() wants),
+// returns its live cells. The region around it is stepped with one cell less at each edge every generation,
+// the cells next to the edge are wrong since the ones past it are not there.
+template<class Chunk>
+int step_chunk_blocked(const Chunk *const *found, const LifeColumnFn life_column, const LifeRule &rule,
+    const int generations, ChunkRegion<Chunk> &region, typename Chunk::Word *result)
+{
+    typedef ChunkRegion<Chunk> Region;
+    typedef typename Chunk::Word Word;
+    static const int side = Chunk::side_len_b;
+    static const int word_bits = Chunk::word_bits;
+    static const uint64_t empty[column_padded_rows] = {};
+    {
+        PROFILE_SCOPE(halo);
+        fill_region(found, generations, region.columns[0]);
+    }
+    PROFILE_SCOPE(compute);
+    const int rows = side + 2 * generations;
+    int cur = 0;
+    for(int g = 1; g <= generations; g++, cur = !cur)
+    {
+        uint64_t (*from)[column_padded_rows] = region.columns[cur];
+        for(int c = 0; c < Region::words; c++)
+        {
+            life_column(c > 0 ? from[c - 1] : empty, from[c], c + 1 < Region::words ? from[c + 1] : empty,
+                region.columns[!cur][c], g, rows - g, rule);
+        }
+    }
+    int live_cells = 0;
+    for(int y = 0; y < side; y++)
+    {
+        for(int w = 0; w < Chunk::row_words; w++)
+        {
+            const int at = Region::pad + w * word_bits;
+            const int c = at >> 6, shift = at & 63;
+            uint64_t bits = region.columns[cur][c][y + generations] >> shift;
+            if(shift + word_bits > 64)
+                bits |= region.columns[cur][c + 1][y + generations] << (64 - shift);
+            result[y * Chunk::row_words + w] = (Word)bits;
+            live_cells += __builtin_popcountll((Word)bits);
+        }
+    }
+    return live_cells;
+}
+
+// The loaded chunks that need computing, and the missing ones that may get births.
+// A chunk with its whole neighbourhood unchanged (still life, period 2) already has its next generation in the other buffer,
+// so only the neighbourhoods of changed chunks are looked at. Missing chunks count as unchanged, see cull().
+template<class Chunk>
+void collect_chunks(ChunkLoader<Chunk> &life, std::vector<ChunkPair<Chunk>*> &pairs, std::vector<Vect2i> &border)
+{
+    static const int side = Chunk::side_len_b;
+    PROFILE_SCOPE(collect);
+    const int cur = life.current();
+    const bool skipping = life.skipping_allowed();
+    life.for_each_pair([&](const Vect2i &chunk_pos, ChunkPair<Chunk> &pair)
+    {
+        if(!skipping)
+        {
+            pairs.push_back(&pair);
+            if(pair.gen[cur].live_cells == 0)
+                return;
+        }
+        else if(!pair.changed)
+            return;
+        for(int i = 0; i < 9; i++)
+        {
+            if(pair.neighbours[i])
+            {
+                if(skipping) // otherwise every chunk is in already
+                    pairs.push_back(pair.neighbours[i]);
+            }
+            else
+                border.push_back({chunk_pos.x + (i / 3 - 1) * side, chunk_pos.y + (i % 3 - 1) * side});
+        }
+    });
+    // chunks sharing a slab are close in address, so this order is cache friendly too
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    std::sort(border.begin(), border.end(), [](const Vect2i &a, const Vect2i &b)
+    {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+    });
+    border.erase(std::unique(border.begin(), border.end()), border.end());
+    PROFILE_COUNT(computed, pairs.size() + border.size());
+    PROFILE_COUNT(skipped, life.chunk_count() - pairs.size());
+}
+
+// Advances life, whole chunks at a time on the packed rows.
+// Reads the current buffer of every chunk, writes the other one, then flips.
+// Skipped chunks keep changed at 0, the buffer they did not write already holds the right cells.
+// With generations > 1 each chunk goes that many generations at once from a wider halo (temporal blocking),
+// so the lookups, halos, stores and new chunks are paid once per tick and the halo cells are computed twice.
+// The skipping still holds, both buffers are then that many generations apart. At most ChunkRegion::pad,
+// returns how many it did.
+template<class Chunk>
+int tick_bitwise(ChunkLoader<Chunk> &life, int generations = 1)
+{
+    static const int words = Chunk::side_len_b * Chunk::row_words;
+    generations = std::min(std::max(generations, 1), ChunkRegion<Chunk>::pad);
+    life.set_tick_generations(generations);
+    const LifeRule rule = life.rule();
+    const auto life_step = life_step_kernel<ChunkHaloFor<Chunk>>(rule);
+    const LifeColumnFn life_column = life_column_kernel(rule);
+    const int cur = life.current();
+    const int next = !cur;
+    std::vector<ChunkPair<Chunk>*> pairs;
+    std::vector<Vect2i> border;
+    collect_chunks(life, pairs, border);
+    ChunkHaloFor<Chunk> halo;
+    ChunkRegion<Chunk> region;
+    typename Chunk::Word result[words];
+    const Chunk *found[9];
+    const CellBox edges = life.census_edges(next);
+    LifeCensus delta;
+    for(size_t i = 0; i < pairs.size(); i++)
+    {
+        find_neighbours(*pairs[i], cur, found);
+        const int live_cells = generations == 1 ? step_chunk(found, life_step, rule, halo, result)
+            : step_chunk_blocked(found, life_column, rule, generations, region, result);
+        PROFILE_SCOPE(store);
+        pairs[i]->store(next, result, live_cells, delta, edges);
+    }
+    for(size_t i = 0; i < border.size(); i++)
+    {
+        {
+            PROFILE_SCOPE(border);
+            find_neighbours(life, border[i], found);
+        }
+        const int live_cells = generations == 1 ? step_chunk(found, life_step, rule, halo, result)
+            : step_chunk_blocked(found, life_column, rule, generations, region, result);
+        if(live_cells != 0) // lazy loading, new chunks have an empty current buffer so nothing else sees them yet
+        {
+            Chunk &chunk = life.load_pair(border[i])->gen[next];
+            chunk.set_rows(result, live_cells);
+            delta.change(edges, 0, CellBox(), live_cells, chunk.box(border[i]));
+        }
+    }
+    life.add_census(next, delta);
+    life.flip();
+    return generations;
+}
+
+// tick_bitwise over the threads of pool.
+// The current buffers are only read (find_chunk() skips the hot cache), and every task writes the next buffer of its own chunk,
+// so the map is only changed after the parallel part.
+template<class Chunk>
+int tick_parallel(ChunkLoader<Chunk> &life, WorkStealingPool &pool, int generations = 1)
+{
+    static const int words = Chunk::side_len_b * Chunk::row_words;
+    struct BorderResult
+    {
+        int live_cells;
+        typename Chunk::Word rows[words];
+    };
+    generations = std::min(std::max(generations, 1), ChunkRegion<Chunk>::pad);
+    life.set_tick_generations(generations);
+    const LifeRule rule = life.rule();
+    const auto life_step = life_step_kernel<ChunkHaloFor<Chunk>>(rule);
+    const LifeColumnFn life_column = life_column_kernel(rule);
+    const int cur = life.current();
+    const int next = !cur;
+    std::vector<ChunkPair<Chunk>*> pairs;
+    std::vector<Vect2i> border;
+    collect_chunks(life, pairs, border);
+    const size_t loaded = pairs.size();
+    // border chunks only get loaded if they end up with live cells
+    std::vector<BorderResult> results(border.size());
+    const CellBox edges = life.census_edges(next);
+    LifeCensus delta;
+    std::mutex delta_lock;
+    pool.parallel_for(loaded + border.size(), 64, [&](size_t begin, size_t end)
+    {
+        LifeCensus range_delta;
+        ChunkHaloFor<Chunk> halo;
+        ChunkRegion<Chunk> region;
+        typename Chunk::Word result[words];
+        const Chunk *found[9];
+        for(size_t i = begin; i < end; i++)
+        {
+            if(i < loaded)
+            {
+                find_neighbours(*pairs[i], cur, found);
+                const int live_cells = generations == 1 ? step_chunk(found, life_step, rule, halo, result)
+                    : step_chunk_blocked(found, life_column, rule, generations, region, result);
+                PROFILE_SCOPE(store);
+                pairs[i]->store(next, result, live_cells, range_delta, edges);
+            }
+            else
+            {
+                BorderResult &res = results[i - loaded];
+                {
+                    PROFILE_SCOPE(border);
+                    find_neighbours(life, border[i - loaded], found);
+                }
+                res.live_cells = generations == 1 ? step_chunk(found, life_step, rule, halo, res.rows)
+                    : step_chunk_blocked(found, life_column, rule, generations, region, res.rows);
+            }
+        }
+        std::lock_guard<std::mutex> lock(delta_lock);
+        delta.add(range_delta);
+    });
+    for(size_t i = 0; i < border.size(); i++)
+    {
+        if(results[i].live_cells != 0)
+        {
+            Chunk &chunk = life.load_pair(border[i])->gen[next];
+            chunk.set_rows(results[i].rows, results[i].live_cells);
+            delta.change(edges, 0, CellBox(), results[i].live_cells, chunk.box(border[i]));
+        }
+    }
+    life.add_census(next, delta);
+    life.flip();
+    return generations;
+}
+
+    // Diehard OLD
+    //arr[front][11][13] = 1;
+    //arr[front][12][13] = 1;
+    //arr[front][12][14] = 1;
+    //arr[front][16][14] = 1;
+    //arr[front][17][14] = 1;
+    //arr[front][18][14] = 1;
+    //arr[front][17][12] = 1;
+    // TODO easier seed inpt, file or text or mouse
+    // Die harder
+    //arr[front][16][16] = 1;
+    //arr[front][17][16] = 1;
+    //arr[front][17][17] = 1;
+    //arr[front][21][17] = 1;
+    //arr[front][22][17] = 1;
+    //arr[front][23][17] = 1;
+    //arr[front][22][15] = 1;
+
+void set_acorn(BoolGrid2D &&c)
+{
+    // Acorn
+    c.set(Vect2i(0,2), 1);
+    c.set(Vect2i(1,4), 1);
+    c.set(Vect2i(2,1), 1);
+    c.set(Vect2i(2,2), 1);
+    c.set(Vect2i(2,5), 1);
+    c.set(Vect2i(2,6), 1);
+    c.set(Vect2i(2,7), 1);
+}
+
+void set_acorn(BoolGrid2D &c)
+{
+    // Acorn
+    c.set(Vect2i(0,2), 1);
+    c.set(Vect2i(1,4), 1);
+    c.set(Vect2i(2,1), 1);
+    c.set(Vect2i(2,2), 1);
+    c.set(Vect2i(2,5), 1);
+    c.set(Vect2i(2,6), 1);
+    c.set(Vect2i(2,7), 1);
+}
+
+void set_glider(BoolGrid2D &&c)
+{
+    // Glider
+    c.set(Vect2i(2,1), 1);
+    c.set(Vect2i(3,2), 1);
+    c.set(Vect2i(1,3), 1);
+    c.set(Vect2i(2,3), 1);
+    c.set(Vect2i(3,3), 1);
+}
+
+void set_glider_b(BoolGrid2D &&c)
+{
+    // Glider
+    c.set(Vect2i(1,2), 1);
+    c.set(Vect2i(2,3), 1);
+    c.set(Vect2i(3,1), 1);
+    c.set(Vect2i(3,2), 1);
+    c.set(Vect2i(3,3), 1);
+}
+
+void set_r_pentomino(BoolGrid2D &&c)
+{
+    // R-pentomino
+    c.set(Vect2i(1,0), 1);
+    c.set(Vect2i(2,0), 1);
+    c.set(Vect2i(0,1), 1);
+    c.set(Vect2i(1,1), 1);
+    c.set(Vect2i(1,2), 1);
+}
+
+template<class Chunk>
+void set_gosper_gun(ChunkLoader<Chunk> &life, const Vect2i &offset = Vect2i())
+{
+    // Gosper glider gun
+    std::istringstream rle(
+        "x = 36, y = 9, rule = B3/S23\n"
+        "24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$2o8bo3bob2o4b\n"
+        "obo$10bo5bo7bo$11bo3bo$12b2o!\n");
+    RleReader(rle).read(life, offset);
+}
+
+// Adds an RLE file to life and switches to its rule, false if it cant be read
+template<class Chunk>
+bool load_rle(ChunkLoader<Chunk> &life, const char *path, const Vect2i &offset = Vect2i())
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "Cant open " << path << '\n';
+        return false;
+    }
+    RleHeader header;
+    if(!RleReader(file).read(life, offset, &header))
+    {
+        std::cerr << path << " is not a valid RLE pattern\n";
+        return false;
+    }
+    LifeRule rule;
+    if(LifeRule::parse(header.rule.c_str(), rule))
+        life.set_rule(rule);
+    else
+        std::cerr << "Rule " << header.rule << " is not supported, running " << life.rule().to_string() << '\n';
+    return true;
+}
+
+template<class Chunk>
+bool save_rle(ChunkLoader<Chunk> &life, const char *path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+    RleWriter(file).write(life);
+    return (bool)file;
+}
+
+// Slow, a virtual get() per cell, but works on any grid. TerminalRenderer is for watching a run
+void print_board_compact(const BoolGrid2D &c, int viewport_size)
+{
+    static const char glyphs[4] = {' ', '\'', '.', ':'};
+    std::string out = "\033c";
+    out.reserve((viewport_size + 3) * (viewport_size / 2 + 3) + 8);
+    out.append(viewport_size, '-');
+    out += '\n';
+    for(int y = 0; y<viewport_size; y+=2)
+    {
+        out += '|';
+        for(int x = 0; x<viewport_size; x++)
+            out += glyphs[c.get({x,y})+c.get({x,y+1})*2];
+        out += "|\n";
+    }
+    out.append(viewport_size, '-');
+    out += '\n';
+    std::cout << std::flush;
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+}
+
+template<class Loader>
+Loader* run_simulation(
+    Loader* life,
+    float tick_delay = 0.5,
+    int simulation_len = -1,
+    bool graphics = true,
+    int viewport_size = 64,
+    Vect2i viewport_offset = Vect2i(-32, -32),
+    bool manual = false,
+    WorkStealingPool *pool = nullptr,
+    bool progress = true,
+    int block = 1, // generations per tick, see tick_bitwise(), frames are drawn once per tick
+    uint64_t first_generation = 0 // generation life is at, for the progress lines of a run restored from a snapshot
+    )
+{
+    std::unique_ptr<TerminalRenderer> screen(graphics ? new TerminalRenderer(viewport_size, viewport_size) : nullptr);
+    for(int i = 0, done = 0; i != simulation_len; i += done)
+    {
+        if(graphics)
+            screen->render(*life, viewport_offset);
+        else if(progress && (first_generation + i) % 10 < (uint64_t)std::max(done, 1))
+            std::cout<<"Generation, chunks: "<< first_generation + i << ", " << life->chunk_count() <<'\n';
+        if(manual)
+            std::cin.ignore(9999, '\n');
+        const int generations = simulation_len < 0 ? block : std::min(block, simulation_len - i);
+        if(pool)
+            done = tick_parallel(*life, *pool, generations);
+        else
+            done = tick_bitwise(*life, generations);
+        life->cull();
+        PROFILE_GENERATIONS(done);
+        if(tick_delay && !manual)
+            usleep(tick_delay * (1<<20));
+    }
+    return life;
+}
+
+// Same as run_simulation, without graphics, for jumps too far to tick through one by one.
+// Null, with life left as it was, if the pattern grew too big for the engine
+BoolChunkLoader* run_hashlife(BoolChunkLoader* life, uint64_t generations)
+{
+    HashLifeEngine engine(1 << 24, life->rule());
+    engine.import_from(*life);
+    if(!engine.step(generations))
+        return nullptr;
+    engine.export_to(*life);
+    return life;
+}
+
+// Copies the current generation of from into to, ORed with what is there, the chunk sizes may differ
+template<class From, class To>
+void copy_cells(ChunkLoader<From> &from, ChunkLoader<To> &to)
+{
+    static const int side = From::side_len_b;
+    static const int stride = (side + 63) / 64;
+    uint64_t rows[side * stride];
+    const int cur = from.current();
+    from.for_each_pair([&](const Vect2i &chunk_pos, ChunkPair<From> &pair)
+    {
+        if(pair.gen[cur].live_cells == 0)
+            return;
+        from.read_region(chunk_pos, side, side, rows, stride);
+        to.write_region(chunk_pos, side, side, rows, stride, BlitMode::merge);
+    });
+}
+
+// Jumps generations ahead with HashLife and prints where it ended up, for patterns that settle into something regular
+template<class Chunk>
+int run_jump(BasicBoolChunkLoader<Chunk> *life, const uint64_t generations)
+{
+    // the engine takes 32 cell chunks
+    BoolChunkLoader cells;
+    copy_cells(*life, cells);
+    cells.set_rule(life->rule());
+    if(!run_hashlife(&cells, generations))
+    {
+        std::cerr << "The pattern grew too big for HashLife before generation " << generations << '\n';
+        return 1;
+    }
+    print_board_compact(Offset2D(&cells, {0, 0}), 64);
+    std::cout << "Final live count: " << cells.population() << '\n';
+    const CellBox box = cells.bounding_box();
+    if(!box.empty())
+        std::cout << "Final bounding box: " << box.min_x << ',' << box.min_y << " to " << box.max_x << ',' << box.max_y << '\n';
+    return 0;
+}
+
+// Calls fn with a std::integral_constant of the chunk side shift for side (32, 64, 128 or 256 cells),
+// so it can build a BasicBoolChunkLoader<BasicBoolChunk<shift>>. False if there are no kernels for that side.
+template<class Fn>
+bool with_chunk_side(const int side, Fn fn)
+{
+    switch (side)
+    {
+    case 32:
+        fn(std::integral_constant<int, 5>());
+        return true;
+    case 64:
+        fn(std::integral_constant<int, 6>());
+        return true;
+    case 128:
+        fn(std::integral_constant<int, 7>());
+        return true;
+    case 256:
+        fn(std::integral_constant<int, 8>());
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Very easy to verify processing integrity
+void set_vertical_pattern(BoolGrid2D&& chunk) {
+    // Create a pattern of vertical lines: live line, two empty lines, repeating
+    for (int x = -10; x < 100; x += 3) {
+        for (int y = -10; y < 100; ++y) {
+            // Set a vertical line at every 3rd x position
+            chunk.set({x, y}, true);
+            chunk.set({x + 1, y}, false);
+            chunk.set({x + 2, y}, false);
+        }
+    }
+}
@@ -0,0 +1,317 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "chunks.cpp"
+
+class Snapshot : public BoolGrid2D
+{
+    /**
+     * @brief Binary checkpoint of a ChunkLoader, read straight from a memory mapped file
+     * Layout: Header, then chunk_count Index entries sorted by (y, x), then from payload_offset (page aligned)
+     * the side * side / 8 packed bytes of each chunk in the same order. Everything is little endian, as in memory.
+     * Lookups binary search the index in the mapping, nothing is parsed or copied on open.
+     * Any chunk side can be restored into a loader of any other, just slower than a straight copy.
+     * Version 2 keeps the rule, as LifeRule::code(), in Header::rule. Version 1 files are Life.
+     */
+public:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t side; // chunk side in cells
+        uint32_t endian; // byte_order as written
+        uint32_t rule; // LifeRule::code(), 0 in version 1
+        uint64_t generation;
+        uint64_t chunk_count;
+        uint64_t index_offset;
+        uint64_t payload_offset;
+    };
+    struct Index
+    {
+        int32_t x, y; // chunk position in cells
+        uint32_t live_cells;
+        uint32_t reserved;
+    };
+    static constexpr char magic[8] = {'L', 'I', 'F', 'E', 'S', 'N', 'A', 'P'};
+    static const uint32_t format_version = 2;
+    static const uint32_t byte_order = 0x01020304;
+
+private:
+    int side = 0; // of the chunks in the file
+    size_t payload_size = 0;
+    const char *data = nullptr;
+    size_t size = 0;
+    const Header *header = nullptr;
+    const Index *index = nullptr;
+    const unsigned char *payloads = nullptr;
+
+    static bool before(const Index &entry, const Vect2i &pos)
+    {
+        return entry.y < pos.y || (entry.y == pos.y && entry.x < pos.x);
+    }
+
+    static bool write_all(const int fd, const void *buf, size_t len)
+    {
+        const char *at = (const char*)buf;
+        while(len > 0)
+        {
+            const ssize_t done = ::write(fd, at, len);
+            if(done < 0)
+                return false;
+            at += done;
+            len -= done;
+        }
+        return true;
+    }
+
+    template<class Chunk>
+    struct Entry
+    {
+        Index index;
+        const Chunk *chunk;
+    };
+
+    // What save() and save_chunks() share, entries get sorted
+    template<class Chunk>
+    static bool write(std::vector<Entry<Chunk>> &entries, const LifeRule &rule, const std::string &path,
+        const uint64_t generation)
+    {
+        static const int payload_size = Chunk::chunk_size;
+        std::sort(entries.begin(), entries.end(), [](const Entry<Chunk> &a, const Entry<Chunk> &b)
+        {
+            return before(a.index, {b.index.x, b.index.y});
+        });
+
+        Header head;
+        memcpy(head.magic, magic, sizeof(magic));
+        head.version = format_version;
+        head.side = Chunk::side_len_b;
+        head.endian = byte_order;
+        head.rule = rule.code();
+        head.generation = generation;
+        head.chunk_count = entries.size();
+        head.index_offset = sizeof(Header);
+        const uint64_t index_end = head.index_offset + entries.size() * sizeof(Index);
+        head.payload_offset = (index_end + 4095) / 4096 * 4096;
+
+        const std::string tmp = path + ".tmp";
+        const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+            return false;
+        // batched so the writes stay big without holding a copy of the universe
+        static const size_t batch = 4096;
+        std::vector<char> buffer;
+        buffer.reserve(batch * payload_size);
+        bool ok = write_all(fd, &head, sizeof(head));
+        for(size_t i = 0; ok && i < entries.size(); i += batch)
+        {
+            buffer.clear();
+            for(size_t j = i; j < std::min(entries.size(), i + batch); j++)
+                buffer.insert(buffer.end(), (const char*)&entries[j].index, (const char*)(&entries[j].index + 1));
+            ok = write_all(fd, buffer.data(), buffer.size());
+        }
+        const std::vector<char> padding(head.payload_offset - index_end, 0);
+        ok = ok && write_all(fd, padding.data(), padding.size());
+        for(size_t i = 0; ok && i < entries.size(); i += batch)
+        {
+            buffer.clear();
+            for(size_t j = i; j < std::min(entries.size(), i + batch); j++)
+                buffer.insert(buffer.end(), (const char*)entries[j].chunk->bytes, (const char*)entries[j].chunk->bytes + payload_size);
+            ok = write_all(fd, buffer.data(), buffer.size());
+        }
+        ok = ok && fsync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        if(ok)
+            ok = rename(tmp.c_str(), path.c_str()) == 0;
+        if(!ok)
+            unlink(tmp.c_str());
+        return ok;
+    }
+
+public:
+    Snapshot()
+    {
+    }
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    // Writes the current generation of life to path, through a temporary file renamed over it at the end,
+    // so a crash mid way leaves the old checkpoint intact
+    template<class Chunk>
+    static bool save(ChunkLoader<Chunk> &life, const std::string &path, const uint64_t generation = 0)
+    {
+        std::vector<Entry<Chunk>> entries;
+        const int cur = life.current();
+        life.for_each_pair([&](const Vect2i &chunk_pos, ChunkPair<Chunk> &pair)
+        {
+            if(pair.gen[cur].live_cells != 0)
+                entries.push_back({{chunk_pos.x, chunk_pos.y, (uint32_t)pair.gen[cur].live_cells, 0}, &pair.gen[cur]});
+        });
+        return write(entries, life.rule(), path, generation);
+    }
+
+    // Same as save(), for chunks copied out of a loader, by position, in any order
+    template<class Chunk>
+    static bool save_chunks(const std::vector<std::pair<Vect2i, Chunk>> &chunks, const LifeRule &rule,
+        const std::string &path, const uint64_t generation = 0)
+    {
+        std::vector<Entry<Chunk>> entries;
+        entries.reserve(chunks.size());
+        for(const auto &chunk : chunks)
+        {
+            if(chunk.second.live_cells != 0)
+                entries.push_back({{chunk.first.x, chunk.first.y, (uint32_t)chunk.second.live_cells, 0}, &chunk.second});
+        }
+        return write(entries, rule, path, generation);
+    }
+
+    // Maps the file, false if it is missing or not a snapshot
+    bool open(const std::string &path)
+    {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat st;
+        if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header))
+        {
+            ::close(fd);
+            return false;
+        }
+        void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file
+        if(mapped == MAP_FAILED)
+            return false;
+        data = (const char*)mapped;
+        size = st.st_size;
+        header = (const Header*)data;
+        side = header->side;
+        payload_size = (size_t)side * side / 8;
+        // the counts and offsets come from the file, so divide rather than multiply, nothing may wrap
+        const bool valid = memcmp(header->magic, magic, sizeof(magic)) == 0
+            && (header->version == 1 || header->version == format_version) && header->endian == byte_order
+            && (header->version == 1 || (header->rule >> 18 == 0 && !(header->rule & 1))) // 9 + 9 bits, no B0
+            && (side == 32 || side == 64 || side == 128 || side == 256)
+            && header->index_offset <= size && header->index_offset % alignof(Index) == 0
+            && header->chunk_count <= (size - header->index_offset) / sizeof(Index)
+            && header->payload_offset <= size && header->chunk_count <= (size - header->payload_offset) / payload_size;
+        if(!valid)
+        {
+            close();
+            return false;
+        }
+        index = (const Index*)(data + header->index_offset);
+        payloads = (const unsigned char*)(data + header->payload_offset);
+        return true;
+    }
+
+    void close()
+    {
+        if(data)
+            munmap((void*)data, size);
+        data = nullptr;
+        header = nullptr;
+        index = nullptr;
+        payloads = nullptr;
+        size = 0;
+        side = 0;
+        payload_size = 0;
+    }
+
+    uint64_t generation() const
+    {
+        return header ? header->generation : 0;
+    }
+
+    size_t chunk_count() const
+    {
+        return header ? header->chunk_count : 0;
+    }
+
+    // Life for version 1 files
+    LifeRule rule() const
+    {
+        return header && header->version >= 2 ? LifeRule::from_code(header->rule) : LifeRule();
+    }
+
+    // Of the chunks in the file, 0 if none is open
+    int chunk_side() const
+    {
+        return side;
+    }
+
+    // Packed bytes of a chunk in the mapping, null if it has no live cells
+    const unsigned char* find(const Vect2i &chunk_pos) const
+    {
+        const Index *end = index + chunk_count();
+        const Index *found = std::lower_bound(index, end, chunk_pos, before);
+        if(found == end || found->x != chunk_pos.x || found->y != chunk_pos.y)
+            return nullptr;
+        return payloads + (found - index) * payload_size;
+    }
+
+    // Very slow, use restore_to() for whole universes
+    bool get(const Vect2i &pos) const override
+    {
+        const int lx = pos.x & (side - 1), ly = pos.y & (side - 1);
+        const unsigned char *bytes = find({pos.x - lx, pos.y - ly});
+        return bytes && get_bit(bytes[(lx >> 3) + ly * (side / 8)], lx & 7);
+    }
+
+    // Snapshots are read only
+    void set(const Vect2i &, bool) override
+    {
+    }
+
+    // Replaces the contents and rule of life with the snapshot, one block copy per chunk if the chunk sizes match.
+    // Returns the generation it was saved at, for the run to go on from
+    template<class Chunk>
+    uint64_t restore_to(ChunkLoader<Chunk> &life) const
+    {
+        life.clear();
+        life.set_rule(rule());
+        if(data)
+            madvise((void*)data, size, MADV_SEQUENTIAL);
+        if(side == Chunk::side_len_b)
+        {
+            for(size_t i = 0; i < chunk_count(); i++)
+            {
+                Chunk *chunk = life.load_chunk({index[i].x, index[i].y});
+                memcpy(chunk->bytes, payloads + i * payload_size, payload_size);
+                chunk->live_cells = index[i].live_cells;
+            }
+            return generation();
+        }
+        // other geometry, each chunk goes in as a bitmap
+        const int stride = (side + 63) / 64;
+        std::vector<uint64_t> rows(side * stride);
+        for(size_t i = 0; i < chunk_count(); i++)
+        {
+            std::fill(rows.begin(), rows.end(), 0);
+            const unsigned char *bytes = payloads + i * payload_size;
+            for(int y = 0; y < side; y++)
+            {
+                for(int x = 0; x < side / 8; x++)
+                    rows[y * stride + x / 8] |= (uint64_t)bytes[y * (side / 8) + x] << (x % 8 * 8);
+            }
+            life.write_region({index[i].x, index[i].y}, side, side, rows.data(), stride, BlitMode::merge);
+        }
+        return generation();
+    }
+
+    ~Snapshot()
+    {
+        close();
+    }
+};
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+
+#include "snapshot.hpp"
+#include "test_cells.hpp"
+
+// Snapshot save, open and restore, and open turning down files that are not snapshots or lie about their sizes
+
+static std::string dir;
+
+std::string path_of(const std::string &name)
+{
+    return dir + "/" + name;
+}
+
+// Overwrites a header field of a saved snapshot
+template<class T>
+void patch(const std::string &path, const size_t offset, const T value)
+{
+    const int fd = ::open(path.c_str(), O_WRONLY);
+    if(fd < 0 || pwrite(fd, &value, sizeof(value), offset) != sizeof(value))
+        check(false, "patching " + path);
+    ::close(fd);
+}
+
+// A fresh copy of a good snapshot, to break
+std::string copy_of(const std::string &from, const std::string &name)
+{
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(path_of(name), std::ios::binary);
+    out << in.rdbuf();
+    return path_of(name);
+}
+
+bool opens(const std::string &path)
+{
+    Snapshot snapshot;
+    return snapshot.open(path);
+}
+
+int main()
+{
+    char dir_template[] = "/tmp/snapshot_tests.XXXXXX";
+    if(!mkdtemp(dir_template))
+    {
+        check(false, "making a temporary directory");
+        return test_result();
+    }
+    dir = dir_template;
+
+    const Cells cells = soup({-100, -70}, 200, 30, 0x9E3779B97F4A7C15ull);
+    const std::string good = path_of("good.snap");
+    {
+        BoolChunkLoader life;
+        set_cells(life, cells);
+        check(Snapshot::save(life, good, 1234) && access((good + ".tmp").c_str(), F_OK) != 0, "save");
+    }
+    {
+        Snapshot snapshot;
+        bool ok = snapshot.open(good) && snapshot.generation() == 1234;
+        BoolChunkLoader life;
+        set_cells(life, cells);
+        size_t live_chunks = 0;
+        for(const auto entry : life.loaded_chunks())
+        {
+            live_chunks += entry.chunk.live_cells != 0;
+            ok = ok && (snapshot.find(entry.pos) != nullptr) == (entry.chunk.live_cells != 0);
+        }
+        check(ok && snapshot.chunk_count() == live_chunks, "open and find");
+        ok = true;
+        for(int y = -110; y < 140; y++)
+        {
+            for(int x = -110; x < 110; x++)
+                ok = ok && snapshot.get({x, y}) == (cells.count({x, y}) != 0);
+        }
+        check(ok, "get straight from the mapping");
+
+        // whatever was in the loader goes
+        BoolChunkLoader restored;
+        set_cells(restored, soup({500, 500}, 50, 50, 7));
+        check(snapshot.restore_to(restored) == 1234 && cells_of(restored) == cells, "restore");
+        // restore writes the chunks behind the census' back, it has to count them again
+        check(restored.population() == (int64_t)cells.size() && restored.bounding_box().min_x == cells.begin()->first
+            && restored.bounding_box().max_x == cells.rbegin()->first, "census after restore");
+    }
+    {
+        // saved with 64 cell chunks, read back with 32 and 256 cell ones
+        BasicBoolChunkLoader<BasicBoolChunk<6>> life;
+        set_cells(life, cells);
+        Snapshot snapshot;
+        bool ok = Snapshot::save(life, path_of("side64.snap"), 99) && snapshot.open(path_of("side64.snap"))
+            && snapshot.chunk_side() == 64;
+        for(const auto &cell : cells)
+            ok = ok && snapshot.get({cell.first, cell.second}) && !snapshot.get({cell.first, cell.second + 200});
+        check(ok, "64 cell chunks open");
+        BoolChunkLoader small;
+        BasicBoolChunkLoader<BasicBoolChunk<8>> big;
+        check(snapshot.restore_to(small) == 99 && cells_of(small) == cells, "64 cell chunks restored into 32 cell ones");
+        check(snapshot.restore_to(big) == 99 && cells_of(big) == cells, "64 cell chunks restored into 256 cell ones");
+    }
+    {
+        BoolChunkLoader life;
+        Snapshot snapshot;
+        check(Snapshot::save(life, path_of("empty.snap")) && snapshot.open(path_of("empty.snap"))
+            && snapshot.chunk_count() == 0 && snapshot.restore_to(life) == 0 && cells_of(life).empty(), "empty universe");
+        check(!Snapshot::save(life, path_of("missing/dir.snap")), "save into a missing directory fails");
+    }
+
+    {
+        // the rule goes with the cells, and version 1 files, from before rules, are Life
+        BoolChunkLoader life;
+        life.set_rule(LifeRule(1 << 3 | 1 << 6, 1 << 2 | 1 << 3));
+        set_cells(life, cells);
+        Snapshot snapshot;
+        BoolChunkLoader restored;
+        check(Snapshot::save(life, path_of("highlife.snap"), 5) && snapshot.open(path_of("highlife.snap"))
+            && snapshot.rule() == life.rule() && snapshot.restore_to(restored) == 5 && restored.rule() == life.rule()
+            && cells_of(restored) == cells, "rule saved and restored");
+        const std::string old = copy_of(path_of("highlife.snap"), "version1.snap");
+        patch(old, offsetof(Snapshot::Header, version), (uint32_t)1);
+        patch(old, offsetof(Snapshot::Header, rule), (uint32_t)0);
+        Snapshot old_snapshot;
+        check(old_snapshot.open(old) && old_snapshot.rule() == LifeRule() && old_snapshot.restore_to(restored) == 5
+            && restored.rule() == LifeRule() && cells_of(restored) == cells, "version 1 is Life");
+    }
+
+    check(!opens(path_of("nothing.snap")), "missing file");
+    {
+        std::ofstream(path_of("glider.rle")) << "x = 3, y = 3, rule = B3/S23\nbo$2bo$3o!\n";
+        check(!opens(path_of("glider.rle")), "an RLE file");
+    }
+    std::string bad = copy_of(good, "magic.snap");
+    patch(bad, offsetof(Snapshot::Header, magic), 'X');
+    check(!opens(bad), "bad magic");
+    bad = copy_of(good, "version.snap");
+    patch(bad, offsetof(Snapshot::Header, version), (uint32_t)99);
+    check(!opens(bad), "unknown version");
+    bad = copy_of(good, "endian.snap");
+    patch(bad, offsetof(Snapshot::Header, endian), (uint32_t)0x04030201);
+    check(!opens(bad), "other byte order");
+    bad = copy_of(good, "side.snap");
+    patch(bad, offsetof(Snapshot::Header, side), (uint32_t)48);
+    check(!opens(bad), "chunk side with no kernels");
+    bad = copy_of(good, "b0.snap");
+    patch(bad, offsetof(Snapshot::Header, rule), LifeRule().code() | 1);
+    check(!opens(bad), "rule with B0");
+    bad = copy_of(good, "rule_bits.snap");
+    patch(bad, offsetof(Snapshot::Header, rule), LifeRule().code() | 1 << 18);
+    check(!opens(bad), "rule with bits past S8");
+    bad = copy_of(good, "short.snap");
+    check(truncate(bad.c_str(), sizeof(Snapshot::Header) - 1) == 0 && !opens(bad), "shorter than a header");
+    bad = copy_of(good, "truncated.snap");
+    {
+        struct stat st;
+        check(stat(bad.c_str(), &st) == 0 && truncate(bad.c_str(), st.st_size - 1) == 0 && !opens(bad), "last chunk cut short");
+    }
+    // counts that multiply out past 64 bits and come back small
+    bad = copy_of(good, "wrap.snap");
+    patch(bad, offsetof(Snapshot::Header, chunk_count), (uint64_t)1 << 60);
+    check(!opens(bad), "chunk count that wraps");
+    bad = copy_of(good, "index_end.snap");
+    patch(bad, offsetof(Snapshot::Header, index_offset), ~(uint64_t)15);
+    check(!opens(bad), "index past the end");
+    bad = copy_of(good, "payload_end.snap");
+    patch(bad, offsetof(Snapshot::Header, payload_offset), ~(uint64_t)4095);
+    check(!opens(bad), "payloads past the end");
+    bad = copy_of(good, "aligned.snap");
+    patch(bad, offsetof(Snapshot::Header, index_offset), (uint64_t)sizeof(Snapshot::Header) + 1);
+    check(!opens(bad), "misaligned index");
+
+    check(system(("rm -r " + dir).c_str()) == 0, "cleaning up");
+    return test_result();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+template<class T>
+class SpscRing
+{
+    /**
+     * @brief Bounded queue for exactly one producer thread and one consumer thread, no locks
+     * Neither side ever waits: push() fails when full and pop() when empty, what to do then is up to the caller.
+     * The indices only grow, the slot is the index modulo the capacity (a power of 2).
+     */
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to push, written by the producer
+
+public:
+    // Holds capacity items, rounded up to a power of 2
+    SpscRing(const size_t capacity)
+    {
+        size_t pow2 = 1;
+        while(pow2 < capacity)
+            pow2 <<= 1;
+        slots.resize(pow2);
+        mask = pow2 - 1;
+    }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only, false and item untouched if full
+    bool push(T &&item)
+    {
+        const size_t at = tail.load(std::memory_order_relaxed);
+        if(at - head.load(std::memory_order_acquire) > mask)
+            return false;
+        slots[at & mask] = std::move(item);
+        tail.store(at + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer only, if push() would fail now
+    bool full() const
+    {
+        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) > mask;
+    }
+
+    // Consumer only, false if empty. The slot is left empty, so a shared_ptr does not keep its object alive in there
+    bool pop(T &item)
+    {
+        const size_t at = head.load(std::memory_order_relaxed);
+        if(at == tail.load(std::memory_order_acquire))
+            return false;
+        item = std::move(slots[at & mask]);
+        slots[at & mask] = T();
+        head.store(at + 1, std::memory_order_release);
+        return true;
+    }
+};
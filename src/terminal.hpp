@@ -0,0 +1,155 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+#include "chunks.cpp"
+
+class TerminalRenderer
+{
+    /**
+     * @brief Draws a viewport of a ChunkLoader with text, two cells per character, like print_board_compact
+     * Cells come out of the packed chunk rows through read_region(), the frame is built in buffers allocated once
+     * and only the characters that changed since the last frame are sent, with cursor moves in between.
+     * A frame is one write() to fd, nothing at all if nothing changed, so it stays cheap over a slow SSH link.
+     */
+    static constexpr char glyphs[4] = {' ', '\'', '.', ':'}; // by top + 2 * bottom
+    // changed characters this close together are joined by resending the ones between, cheaper than a cursor move
+    static const int max_gap = 4;
+
+    int fd;
+    int width, height; // in cells
+    int columns, lines; // characters of the board, without the border
+    size_t stride; // words per bitmap row
+    std::vector<uint64_t> cells; // packed, as read_region() writes them
+    std::vector<char> screen, shown; // characters of this frame and the one on the terminal
+    std::string out;
+    bool drawn = false; // false until the border and the first full frame are on the terminal
+
+    void move_to(const int line, const int column)
+    {
+        char escape[24];
+        const int len = snprintf(escape, sizeof(escape), "\033[%d;%dH", line, column);
+        out.append(escape, len);
+    }
+
+    // Board line y, characters between the border, at terminal line y + 2 and column x + 2
+    void diff_line(const int y)
+    {
+        const char *now = &screen[(size_t)y * columns];
+        char *before = &shown[(size_t)y * columns];
+        int cursor = -1; // column right after the last character sent on this line
+        for(int x = 0; x < columns; x++)
+        {
+            if(now[x] == before[x])
+                continue;
+            if(cursor < 0 || x - cursor > max_gap)
+                move_to(y + 2, x + 2);
+            else
+                out.append(now + cursor, x - cursor);
+            out += now[x];
+            before[x] = now[x];
+            cursor = x + 1;
+        }
+    }
+
+    bool write_out()
+    {
+        const char *at = out.data();
+        size_t len = out.size();
+        while(len > 0)
+        {
+            const ssize_t done = ::write(fd, at, len);
+            if(done < 0 && errno == EINTR)
+                continue;
+            if(done < 0)
+                return false;
+            at += done;
+            len -= done;
+        }
+        return true;
+    }
+
+    // Builds the characters of the frame in cells and sends what changed, false if the write failed
+    bool draw()
+    {
+        if(height & 1) // the bottom half of the last line is outside the viewport
+            std::fill(cells.end() - stride, cells.end(), 0);
+        for(int y = 0; y < lines; y++)
+        {
+            const uint64_t *top = &cells[(size_t)y * 2 * stride], *bottom = top + stride;
+            char *line = &screen[(size_t)y * columns];
+            for(size_t w = 0; w < stride; w++)
+            {
+                const int end = std::min<int>(64, columns - w * 64);
+                for(int x = 0; x < end; x++)
+                    line[w * 64 + x] = glyphs[(top[w] >> x & 1) | (bottom[w] >> x & 1) << 1];
+            }
+        }
+        out.clear();
+        if(!drawn)
+        {
+            // clear, then the border, with the board as blanks so diffing fills it in
+            out += "\033[H\033[2J";
+            out.append(columns, '-');
+            out += '\n';
+            for(int y = 0; y < lines; y++)
+            {
+                out += '|';
+                out.append(columns, ' ');
+                out += "|\n";
+            }
+            out.append(columns, '-');
+            out += '\n';
+            std::fill(shown.begin(), shown.end(), ' ');
+            drawn = true;
+        }
+        for(int y = 0; y < lines; y++)
+            diff_line(y);
+        if(out.empty())
+            return true;
+        move_to(lines + 3, 1); // under the board, for whatever gets printed next
+        return write_out();
+    }
+
+public:
+    // width x height cells, drawn into a terminal at least width + 2 columns and height / 2 + 3 lines big
+    TerminalRenderer(const int width, const int height, const int fd = STDOUT_FILENO)
+        : fd(fd), width(std::max(1, width)), height(std::max(1, height))
+    {
+        columns = this->width;
+        lines = (this->height + 1) / 2;
+        stride = (this->width + 63) / 64;
+        cells.resize(stride * (lines * 2));
+        screen.resize((size_t)columns * lines);
+        shown.resize(screen.size());
+        // worst case is every character with a cursor move in front, plus the border
+        out.reserve(screen.size() * 16 + (size_t)(columns + 3) * (lines + 2) + 64);
+    }
+
+    // Draws everything again on the next frame, for when something else wrote to the terminal
+    void invalidate()
+    {
+        drawn = false;
+    }
+
+    // Shows the cells from view_pos on, false if the write failed
+    template<class Chunk>
+    bool render(const ChunkLoader<Chunk> &life, const Vect2i &view_pos)
+    {
+        life.read_region(view_pos, width, height, cells.data(), stride);
+        return draw();
+    }
+
+    // Shows width x height cells read out earlier, laid out as read_region() writes them with (width + 63) / 64
+    // words per row, for frames copied out of the loader on another thread
+    bool render_rows(const uint64_t *rows)
+    {
+        std::copy(rows, rows + stride * height, cells.begin());
+        return draw();
+    }
+};
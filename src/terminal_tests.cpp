@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "terminal.hpp"
+#include "test_cells.hpp"
+
+// TerminalRenderer output played back on a pretend terminal, which has to end up showing the cells after every frame,
+// with frames that change nothing writing nothing
+
+// Just enough of a terminal for what the renderer sends: text, newlines, clear and cursor moves
+struct Screen
+{
+    std::vector<std::string> lines;
+    int line = 0, column = 0;
+
+    Screen() : lines(100, std::string(200, ' '))
+    {
+    }
+
+    // false on anything it does not know
+    bool play(const std::string &bytes)
+    {
+        for(size_t i = 0; i < bytes.size(); i++)
+        {
+            if(bytes[i] == '\n')
+            {
+                line++;
+                column = 0;
+            }
+            else if(bytes[i] != '\033')
+                lines.at(line).at(column++) = bytes[i];
+            else if(bytes.compare(i, 3, "\033[H") == 0)
+            {
+                line = column = 0;
+                i += 2;
+            }
+            else if(bytes.compare(i, 4, "\033[2J") == 0)
+            {
+                for(std::string &text : lines)
+                    text.assign(text.size(), ' ');
+                i += 3;
+            }
+            else
+            {
+                int to_line, to_column, len;
+                if(sscanf(bytes.c_str() + i, "\033[%d;%dH%n", &to_line, &to_column, &len) != 2)
+                    return false;
+                line = to_line - 1;
+                column = to_column - 1;
+                i += len - 1;
+            }
+        }
+        return true;
+    }
+
+    // The board at its place under the border, as it should look for cells
+    bool shows(const Cells &cells, const Vect2i &view_pos, const int width, const int height) const
+    {
+        for(int y = 0; y < (height + 1) / 2; y++)
+        {
+            for(int x = 0; x < width; x++)
+            {
+                const int top = cells.count({view_pos.x + x, view_pos.y + y * 2});
+                const int bottom = y * 2 + 1 < height && cells.count({view_pos.x + x, view_pos.y + y * 2 + 1});
+                if(lines[y + 1][x + 1] != " '.:"[top + bottom * 2])
+                    return false;
+            }
+        }
+        return lines[0].compare(0, width, std::string(width, '-')) == 0;
+    }
+};
+
+std::string drain(const int fd)
+{
+    std::string bytes;
+    char buffer[4096];
+    ssize_t len;
+    while((len = read(fd, buffer, sizeof(buffer))) > 0)
+        bytes.append(buffer, len);
+    return bytes;
+}
+
+void check_frames(const int width, const int height, const Vect2i &view_pos)
+{
+    const std::string what = std::to_string(width) + "x" + std::to_string(height) + " ";
+    int pipe_fds[2];
+    if(pipe(pipe_fds) != 0 || fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK) != 0)
+    {
+        check(false, what + "pipe");
+        return;
+    }
+    TerminalRenderer renderer(width, height, pipe_fds[1]);
+    Screen screen;
+    BoolChunkLoader life;
+    Cells cells = soup({-50, -40}, 100, 30, 0x9E3779B97F4A7C15ull);
+    set_cells(life, cells);
+    bool ok = renderer.render(life, view_pos);
+    const std::string first = drain(pipe_fds[0]);
+    check(ok && screen.play(first) && screen.shows(cells, view_pos, width, height), what + "first frame");
+    check(renderer.render(life, view_pos) && drain(pipe_fds[0]).empty(), what + "nothing changed, nothing written");
+
+    // a few cells flipped is a few characters, each at worst a cursor move and itself, then the move under the board
+    uint64_t state = 77;
+    for(int i = 0; i < 5; i++)
+    {
+        const Vect2i cell = {view_pos.x + (int)(next_random(state) % width), view_pos.y + (int)(next_random(state) % height)};
+        const bool live = !cells.count({cell.x, cell.y});
+        life.set(cell, live);
+        if(live)
+            cells.insert({cell.x, cell.y});
+        else
+            cells.erase({cell.x, cell.y});
+    }
+    ok = renderer.render(life, view_pos);
+    const std::string diff = drain(pipe_fds[0]);
+    check(ok && screen.play(diff) && screen.shows(cells, view_pos, width, height) && !diff.empty()
+        && diff.size() <= 6 * 16, what + "small change, small frame");
+
+    // a whole new board
+    BoolChunkLoader other;
+    cells = soup({-50, -40}, 100, 50, 5);
+    set_cells(other, cells);
+    ok = renderer.render(other, view_pos);
+    check(ok && screen.play(drain(pipe_fds[0])) && screen.shows(cells, view_pos, width, height), what + "everything changed");
+
+    // something else wrote over the terminal
+    Screen fresh;
+    renderer.invalidate();
+    check(renderer.render(other, view_pos) && fresh.play(drain(pipe_fds[0])) && fresh.shows(cells, view_pos, width, height),
+        what + "drawn again after invalidate");
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+int main()
+{
+    check_frames(64, 64, {-32, -32});
+    check_frames(130, 41, {-61, -17}); // past a word, an odd height and nothing lined up with chunks
+    check_frames(1, 1, {0, 0});
+    return test_result();
+}
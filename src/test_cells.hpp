@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <set>
+#include <utility>
+
+#include "chunks.cpp"
+#include "tests.hpp"
+
+// Patterns as plain sets of cells, for the tests that check what ends up in a ChunkLoader of any chunk side
+
+typedef std::set<std::pair<int, int>> Cells;
+
+// size x size cells from corner, percent of them live
+inline Cells soup(const Vect2i &corner, const int size, const int percent, uint64_t state)
+{
+    Cells cells;
+    for(int y = 0; y < size; y++)
+    {
+        for(int x = 0; x < size; x++)
+        {
+            if(next_random(state) % 100 < (uint64_t)percent)
+                cells.insert({corner.x + x, corner.y + y});
+        }
+    }
+    return cells;
+}
+
+template<class Chunk>
+void set_cells(ChunkLoader<Chunk> &life, const Cells &cells)
+{
+    for(const auto &cell : cells)
+        life.set({cell.first, cell.second}, 1);
+}
+
+template<class Chunk>
+Cells cells_of(const ChunkLoader<Chunk> &life)
+{
+    Cells cells;
+    for(const auto entry : life.loaded_chunks())
+    {
+        for(int y = 0; y < Chunk::side_len_b; y++)
+        {
+            for(int x = 0; x < Chunk::side_len_b; x++)
+            {
+                if(entry.chunk.get({x, y}))
+                    cells.insert({entry.pos.x + x, entry.pos.y + y});
+            }
+        }
+    }
+    return cells;
+}
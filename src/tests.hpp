@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+// Bits shared by the *_tests.cpp programs, ctest runs each one.
+// Every check prints a line, main returns test_result() so a failed check fails the test.
+
+static int failures = 0;
+
+inline void check(const bool ok, const std::string &what)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    fflush(stdout);
+    if(!ok)
+        failures++;
+}
+
+inline int test_result()
+{
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
+
+// xorshift, the same numbers on every machine
+inline uint64_t next_random(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <memory>
+
+class WorkStealingPool
+{
+    /**
+     * @brief Fixed set of threads for data parallel loops
+     * Each thread gets a slice of the index range, and when done, steals half of what is left in someone elses.
+     * The calling thread works too, so a pool of 1 runs everything inline.
+     */
+    struct Slice
+    {
+        std::mutex lock;
+        size_t begin = 0, end = 0;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Slice>> slices;
+    std::mutex lock;
+    std::condition_variable wake, done;
+    const std::function<void(size_t, size_t)> *job = nullptr;
+    size_t grain = 1;
+    size_t job_id = 0;
+    int busy = 0;
+    bool quit = false;
+
+    // Takes up to grain indices from the front of our own slice
+    bool take(int id, size_t &begin, size_t &end)
+    {
+        Slice &own = *slices[id];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(own.begin == own.end)
+            return false;
+        begin = own.begin;
+        end = std::min(own.end, own.begin + grain);
+        own.begin = end;
+        return true;
+    }
+
+    // Moves the back half of the first non-empty slice into ours
+    bool steal(int id)
+    {
+        const int count = slices.size();
+        for(int i = 1; i < count; i++)
+        {
+            Slice &victim = *slices[(id + i) % count];
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> guard(victim.lock);
+                size_t left = victim.end - victim.begin;
+                if(left == 0)
+                    continue;
+                begin = victim.end - (left - left / 2);
+                end = victim.end;
+                victim.end = begin;
+            }
+            // never hold two slice locks at once
+            Slice &own = *slices[id];
+            std::lock_guard<std::mutex> guard(own.lock);
+            own.begin = begin;
+            own.end = end;
+            return true;
+        }
+        return false;
+    }
+
+    void work(int id)
+    {
+        size_t begin, end;
+        do
+        {
+            while(take(id, begin, end))
+                (*job)(begin, end);
+        } while(steal(id));
+    }
+
+    void worker_loop(int id)
+    {
+        size_t seen = 0;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&]{ return quit || job_id != seen; });
+                if(quit)
+                    return;
+                seen = job_id;
+            }
+            work(id);
+            std::lock_guard<std::mutex> guard(lock);
+            if(--busy == 0)
+                done.notify_one();
+        }
+    }
+
+public:
+    // 0 threads means one per hardware thread
+    WorkStealingPool(int thread_count = 0)
+    {
+        if(thread_count <= 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        for(int i = 0; i < thread_count; i++)
+            slices.emplace_back(new Slice);
+        for(int i = 1; i < thread_count; i++)
+            threads.emplace_back(&WorkStealingPool::worker_loop, this, i);
+    }
+
+    int size() const
+    {
+        return slices.size();
+    }
+
+    // Calls fn(begin, end) over [0, count) in blocks of at most grain, returns when all are done
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn)
+    {
+        if(count == 0)
+            return;
+        if(count <= grain || threads.empty())
+        {
+            // not worth waking anyone
+            fn(0, count);
+            return;
+        }
+        const size_t per_thread = (count + slices.size() - 1) / slices.size();
+        for(size_t i = 0; i < slices.size(); i++)
+        {
+            slices[i]->begin = std::min(count, i * per_thread);
+            slices[i]->end = std::min(count, (i + 1) * per_thread);
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            job = &fn;
+            this->grain = std::max<size_t>(grain, 1);
+            busy = threads.size();
+            job_id++;
+        }
+        wake.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&]{ return busy == 0; });
+        job = nullptr;
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            quit = true;
+        }
+        wake.notify_all();
+        for(auto iter = threads.begin(); iter != threads.end(); ++iter)
+            iter->join();
+    }
+};
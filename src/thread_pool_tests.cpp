@@ -0,0 +1,43 @@
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "tests.hpp"
+
+// Every index of a parallel_for is handed out exactly once, whatever the pool size, grain and count,
+// and back to back jobs do not leak into each other
+
+int main()
+{
+    for(const int threads : {1, 2, 5})
+    {
+        WorkStealingPool pool(threads);
+        for(const size_t count : {0, 1, 7, 64, 1000, 100003})
+        {
+            for(const size_t grain : {1, 3, 64, 5000})
+            {
+                std::vector<std::atomic<int>> seen(count);
+                std::atomic<bool> bad_block{false};
+                // a few rounds, so a worker still finishing the last job would show up as a double count
+                for(int round = 0; round < 3; round++)
+                {
+                    pool.parallel_for(count, grain, [&](size_t begin, size_t end)
+                    {
+                        // a pool of 1, or a count within one grain, runs it all in one go
+                        if(begin >= end || end > count || (threads > 1 && count > grain && end - begin > grain))
+                            bad_block = true;
+                        for(size_t i = begin; i < end && i < count; i++)
+                            seen[i]++;
+                    });
+                }
+                bool ok = !bad_block;
+                for(size_t i = 0; i < count; i++)
+                    ok = ok && seen[i] == 3;
+                check(ok, "threads " + std::to_string(threads) + " count " + std::to_string(count) + " grain "
+                    + std::to_string(grain));
+            }
+        }
+    }
+    return test_result();
+}